@@ -0,0 +1,25 @@
+#!/bin/bash
+# Time compiling bench/constexpr_table.cpp for growing table sizes.
+# Usage: compile_time.sh [compiler] [sizes...]
+
+cxx="${1:-c++}"
+shift
+sizes="${@:-16 32 64 128 256 512}"
+dir="$(cd "$(dirname "$0")" && pwd)"
+
+if $cxx --version | grep -q clang; then
+    limits="-fconstexpr-steps=2147483647"
+else
+    limits="-fconstexpr-ops-limit=17179869184 -fconstexpr-loop-limit=1073741824"
+fi
+
+TIMEFORMAT="%R"
+printf "%-8s %-12s %s\n" "size" "value bits" "seconds"
+for size in $sizes; do
+    for bits in 8 32; do
+        seconds=$( { time $cxx -std=c++17 -fsyntax-only $limits \
+            -I"$dir/../include" -DTABLE_SIZE="$size" -DVALUE_BITS="$bits" \
+            "$dir/constexpr_table.cpp" >/dev/null; } 2>&1 ) || exit 1
+        printf "%-8s %-12s %s\n" "$size" "$bits" "$seconds"
+    done
+done
@@ -0,0 +1,36 @@
+// Compile-time cost of ConstexprInterpolate.h for a table of TABLE_SIZE
+// pseudo-random entries below 2^VALUE_BITS. Compiling this file is the
+// benchmark, the static_assert checks every entry.
+
+#include "ConstexprInterpolate.h"
+
+#ifndef TABLE_SIZE
+#define TABLE_SIZE 256
+#endif
+#ifndef VALUE_BITS
+#define VALUE_BITS 8
+#endif
+
+static constexpr std::array<uint32_t, TABLE_SIZE> MakeTable() {
+  std::array<uint32_t, TABLE_SIZE> Table{};
+  uint64_t State = 0x853c49e6748fea9bULL;
+  for (auto &Value : Table) {
+    State = State * 6364136223846793005ULL + 1442695040888963407ULL;
+    Value = static_cast<uint32_t>(State >> 33) & ((1ULL << VALUE_BITS) - 1);
+  }
+  return Table;
+}
+
+static constexpr auto Table = MakeTable();
+using Poly = interpolate::InterpolatedTable<Table>;
+
+static constexpr bool Check() {
+  for (size_t i = 0; i < Table.size(); i++) {
+    if (Poly::get(i) != Table[i])
+      return false;
+  }
+  return true;
+}
+static_assert(Check(), "Polynomial does not reproduce the table.");
+
+int main() { return 0; }
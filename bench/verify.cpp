@@ -0,0 +1,508 @@
+// Differential test of the pass. Random tables of varying sizes and value
+// widths are interpolated over both fields, read through every access shape
+// the pass rewrites, JIT compiled and compared against the table. Tables are
+// also instrumented, with and without sampling, or carry a profile marking a
+// read hot. The constexpr engine is checked against the same tables.
+//
+// With -DINTERPOLATE_LIBFUZZER and -fsanitize=fuzzer this is a libFuzzer
+// target, otherwise it checks random tables on every core and reports the
+// throughput.
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Signals.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Compile.h"
+#include "ConstexprInterpolate.h"
+#include "Interpolate.h"
+#include "Pass.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// From libgcc, for the i128 arithmetic of large moduli.
+extern "C" unsigned __int128 __umodti3(unsigned __int128, unsigned __int128);
+
+static constexpr size_t kMaxSize = 256;
+static constexpr unsigned kLanes = 4;
+
+struct TableSpec {
+  bool Binary;
+  bool PCLMUL;
+  bool Instrument;
+  unsigned SamplePeriod;
+  bool Hot;
+  std::vector<uint32_t> Values;
+};
+
+static bool hostHasPCLMUL() {
+  StringMap<bool> Features;
+  return sys::getHostCPUFeatures(Features) && Features.lookup("pclmul");
+}
+
+// Layout: flags, value width, two bytes of size, then the values, four
+// bytes each. Missing bytes read as zero. The flags are GF(2^k), pclmul,
+// instrumented and hot in the low bits, the sample period in the high ones.
+static TableSpec decodeSpec(const uint8_t *Data, size_t Size) {
+  auto Byte = [&](size_t i) -> uint32_t { return i < Size ? Data[i] : 0; };
+  static const bool PCLMUL = hostHasPCLMUL();
+
+  TableSpec Spec;
+  Spec.Binary = Byte(0) & 1;
+  Spec.PCLMUL = (Byte(0) & 2) && PCLMUL;
+  Spec.Instrument = Byte(0) & 4;
+  Spec.SamplePeriod = Spec.Instrument ? Byte(0) >> 4 : 0;
+  Spec.Hot = Byte(0) & 8;
+  unsigned Bits = Byte(1) % 32 + 1;
+  size_t Count = (Byte(2) | Byte(3) << 8) % kMaxSize + 1;
+  for (size_t i = 0; i < Count; i++) {
+    size_t At = 4 + 4 * i;
+    uint32_t Value =
+        Byte(At) | Byte(At + 1) << 8 | Byte(At + 2) << 16 | Byte(At + 3) << 24;
+    Spec.Values.push_back(Bits == 32 ? Value : Value & ((1u << Bits) - 1));
+  }
+  return Spec;
+}
+
+// The slice read_slice(i) = T[Offset + (i & Mask)] reaches, the upper half
+// of the table rounded down to a power of two.
+static std::pair<uint64_t, uint64_t> getSlice(size_t Size) {
+  uint64_t Mask = Size < 2 ? 0 : PowerOf2Floor(Size) / 2 - 1;
+  return {Size - 1 - Mask, Mask};
+}
+
+// A table T annotated for the field of Spec and functions reading it with a
+// plain load, a masked index, a vector load and a memcpy. With Spec.Hot, the
+// module has a profile in which only read is hot.
+static std::string buildModuleIR(const TableSpec &Spec) {
+  auto N = Spec.Values.size();
+  auto Array = "[" + std::to_string(N) + " x i32]";
+  std::string Anno = Spec.Binary ? "interpolate_gf" : "interpolate";
+  auto AnnoArray = "[" + std::to_string(Anno.size() + 1) + " x i8]";
+  auto [Offset, Mask] = getSlice(N);
+  std::string Attrs = Spec.PCLMUL ? " #0" : "";
+
+  std::string IR;
+  raw_string_ostream OS(IR);
+  OS << "target triple = \"" << sys::getProcessTriple() << "\"\n";
+  OS << "@T = internal constant " << Array << " [";
+  for (size_t i = 0; i < N; i++) {
+    OS << (i ? ", " : "") << "i32 " << Spec.Values[i];
+  }
+  OS << "], align 16\n";
+  OS << "@.anno = private constant " << AnnoArray << " c\"" << Anno
+     << "\\00\", section \"llvm.metadata\"\n";
+  OS << "@.file = private constant [8 x i8] c\"table.c\\00\", "
+        "section \"llvm.metadata\"\n";
+  OS << "@llvm.global.annotations = appending global "
+        "[1 x { i8*, i8*, i8*, i32, i8* }] [{ i8*, i8*, i8*, i32, i8* } "
+        "{ i8* bitcast ("
+     << Array << "* @T to i8*), i8* getelementptr (" << AnnoArray << ", "
+     << AnnoArray << "* @.anno, i32 0, i32 0), i8* getelementptr "
+     << "([8 x i8], [8 x i8]* @.file, i32 0, i32 0), i32 1, i8* null }], "
+        "section \"llvm.metadata\"\n";
+  OS << "declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i1)\n";
+
+  OS << "define i32 @read(i64 %i)" << Attrs << (Spec.Hot ? " !prof !14" : "")
+     << " {\n"
+     << "  %p = getelementptr inbounds " << Array << ", " << Array
+     << "* @T, i64 0, i64 %i\n"
+     << "  %v = load i32, i32* %p\n"
+     << "  ret i32 %v\n}\n";
+
+  OS << "define i32 @read_slice(i64 %i)" << Attrs << " {\n"
+     << "  %m = and i64 %i, " << Mask << "\n"
+     << "  %o = add nuw nsw i64 %m, " << Offset << "\n"
+     << "  %p = getelementptr inbounds " << Array << ", " << Array
+     << "* @T, i64 0, i64 %o\n"
+     << "  %v = load i32, i32* %p\n"
+     << "  ret i32 %v\n}\n";
+
+  if (N >= kLanes) {
+    OS << "define void @read_v4(i64 %i, <4 x i32>* %d)" << Attrs << " {\n"
+       << "  %p = getelementptr inbounds " << Array << ", " << Array
+       << "* @T, i64 0, i64 %i\n"
+       << "  %q = bitcast i32* %p to <4 x i32>*\n"
+       << "  %v = load <4 x i32>, <4 x i32>* %q, align 4\n"
+       << "  store <4 x i32> %v, <4 x i32>* %d, align 4\n"
+       << "  ret void\n}\n";
+  }
+
+  OS << "define void @copy(i8* %d)" << Attrs << " {\n"
+     << "  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* bitcast ("
+     << Array << "* @T to i8*), i64 " << 4 * N << ", i1 false)\n"
+     << "  ret void\n}\n";
+
+  if (Spec.PCLMUL) {
+    OS << "attributes #0 = { \"target-features\"=\"+pclmul\" }\n";
+  }
+
+  // Counts of at least 100 are hot.
+  if (Spec.Hot) {
+    OS << "!llvm.module.flags = !{!0}\n"
+       << "!0 = !{i32 1, !\"ProfileSummary\", !1}\n"
+       << "!1 = !{!2, !3, !4, !5, !6, !7, !8, !9}\n"
+       << "!2 = !{!\"ProfileFormat\", !\"InstrProf\"}\n"
+       << "!3 = !{!\"TotalCount\", i64 10000}\n"
+       << "!4 = !{!\"MaxCount\", i64 10}\n"
+       << "!5 = !{!\"MaxInternalCount\", i64 1}\n"
+       << "!6 = !{!\"MaxFunctionCount\", i64 1000}\n"
+       << "!7 = !{!\"NumCounts\", i64 3}\n"
+       << "!8 = !{!\"NumFunctions\", i64 3}\n"
+       << "!9 = !{!\"DetailedSummary\", !10}\n"
+       << "!10 = !{!11, !12, !13}\n"
+       << "!11 = !{i32 10000, i64 100, i32 1}\n"
+       << "!12 = !{i32 999000, i64 100, i32 1}\n"
+       << "!13 = !{i32 999999, i64 1, i32 2}\n"
+       << "!14 = !{!\"function_entry_count\", i64 1000}\n";
+  }
+  return OS.str();
+}
+
+template <typename T> static T lookup(LLJIT &J, StringRef Name) {
+  auto Symbol = J.lookup(Name);
+  if (!Symbol) {
+    consumeError(Symbol.takeError());
+    return nullptr;
+  }
+#if LLVM_VERSION_MAJOR >= 15
+  return Symbol->toPtr<T>();
+#else
+  return jitTargetAddressToPointer<T>(Symbol->getAddress());
+#endif
+}
+
+static std::string mismatch(StringRef Read, uint64_t Index, uint32_t Value,
+                            uint32_t Expected) {
+  return (Read + "(" + Twine(Index) + ") = " + Twine(Value) + ", expected " +
+          Twine(Expected))
+      .str();
+}
+
+// The constexpr engine must give the modulus and coefficients of
+// LagrangeInterpolate, and their evaluation the table. It needs the size at
+// compile time, so only some sizes are checked.
+template <size_t N>
+static std::string verifyConstexpr(const std::vector<uint32_t> &Values,
+                                   const std::vector<Point> &Points) {
+  std::array<uint32_t, N> Table;
+  std::copy(Values.begin(), Values.end(), Table.begin());
+  auto P = interpolate::Interpolate(Table);
+  auto [Coefficients, Modulus] = LagrangeInterpolate(Points);
+  if (P.Modulus != Modulus) {
+    return ("constexpr modulus " + Twine(P.Modulus) + ", expected " +
+            Twine(Modulus))
+        .str();
+  }
+  for (size_t k = 0; k < N; k++) {
+    int64_t Expected = k < Coefficients.size() ? Coefficients[k] : 0;
+    if (P.Coefficients[k] != Expected) {
+      return ("constexpr coefficient " + Twine(k) + " = " +
+              Twine(P.Coefficients[k]) + ", expected " + Twine(Expected))
+          .str();
+    }
+  }
+  for (size_t i = 0; i < N; i++) {
+    if (auto Value = interpolate::Evaluate(P, i); Value != Values[i]) {
+      return mismatch("Evaluate", i, Value, Values[i]);
+    }
+  }
+  return "";
+}
+
+static std::string verifyConstexpr(const TableSpec &Spec,
+                                   const std::vector<Point> &Points) {
+  switch (Spec.Values.size()) {
+  case 1:
+    return verifyConstexpr<1>(Spec.Values, Points);
+  case 7:
+    return verifyConstexpr<7>(Spec.Values, Points);
+  case 16:
+    return verifyConstexpr<16>(Spec.Values, Points);
+  case 61:
+    return verifyConstexpr<61>(Spec.Values, Points);
+  case 256:
+    return verifyConstexpr<256>(Spec.Values, Points);
+  default:
+    return "";
+  }
+}
+
+// Counters of an instrumented table, as in runtime/profile.c. The module
+// constructors register them with the thread running the JIT.
+struct InterpolateRecord {
+  const char *Name;
+  uint64_t Lookups;
+  uint64_t Cycles;
+  uint64_t Samples;
+  uint64_t Powers;
+  InterpolateRecord *Next;
+};
+static thread_local std::vector<InterpolateRecord *> Records;
+
+static void registerRecord(InterpolateRecord *Record) {
+  Records.push_back(Record);
+}
+
+static void transformTable(Module &M, const TableSpec &Spec) {
+  InterpolateOptions Options;
+  Options.Instrument = Spec.Instrument;
+  Options.SamplePeriod = Spec.SamplePeriod;
+  transformModule(M, Options);
+}
+
+// Returns what went wrong, or an empty string. Rewritten is set when the
+// pass interpolated the table.
+static std::string verifyTable(const TableSpec &Spec, bool &Rewritten) {
+  const auto &Values = Spec.Values;
+  auto N = Values.size();
+
+  auto Context = std::make_unique<LLVMContext>();
+  auto M = CompileModuleIR(buildModuleIR(Spec), *Context);
+  if (!M) {
+    return "invalid test module";
+  }
+  transformTable(*M, Spec);
+  if (verifyModule(*M, &errs())) {
+    return "invalid module after transformation";
+  }
+
+  // Tables are left alone only when too wide for GF(2^k). The table stays
+  // for the hot read otherwise.
+  std::vector<Point> Points;
+  for (size_t i = 0; i < N; i++) {
+    Points.push_back({i, Values[i]});
+  }
+  bool Expected = !Spec.Binary || IsGFRepresentable(Points);
+  Rewritten = !M->getNamedGlobal("llvm.global.annotations");
+  if (Rewritten != Expected) {
+    return Expected ? "table was not rewritten" : "table was rewritten";
+  }
+  if (Rewritten && Spec.Hot != !!M->getNamedGlobal("T")) {
+    return Spec.Hot ? "hot read was rewritten" : "table was kept";
+  }
+  if (Rewritten && Spec.Binary && Spec.PCLMUL &&
+      !M->getFunction("llvm.x86.pclmulqdq")) {
+    return "pclmulqdq was not used";
+  }
+
+  auto J = LLJITBuilder().create();
+  if (!J) {
+    return toString(J.takeError());
+  }
+  auto &JD = (*J)->getMainJITDylib();
+  MangleAndInterner Mangle((*J)->getExecutionSession(), (*J)->getDataLayout());
+  cantFail(JD.define(absoluteSymbols(
+      {{Mangle("__umodti3"),
+        JITEvaluatedSymbol(pointerToJITTargetAddress(&__umodti3),
+                           JITSymbolFlags::Exported)},
+       {Mangle("__interpolate_register"),
+        JITEvaluatedSymbol(pointerToJITTargetAddress(&registerRecord),
+                           JITSymbolFlags::Exported)}})));
+  JD.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*J)->getDataLayout().getGlobalPrefix())));
+  if (auto Err = (*J)->addIRModule(
+          ThreadSafeModule(std::move(M), std::move(Context)))) {
+    return toString(std::move(Err));
+  }
+  Records.clear();
+  if (auto Err = (*J)->initialize(JD)) {
+    return toString(std::move(Err));
+  }
+
+  auto *Read = lookup<uint32_t (*)(uint64_t)>(**J, "read");
+  auto *ReadSlice = lookup<uint32_t (*)(uint64_t)>(**J, "read_slice");
+  auto *Copy = lookup<void (*)(uint32_t *)>(**J, "copy");
+  if (!Read || !ReadSlice || !Copy) {
+    return "missing read function";
+  }
+  for (size_t i = 0; i < N; i++) {
+    if (auto Value = Read(i); Value != Values[i]) {
+      return mismatch("read", i, Value, Values[i]);
+    }
+  }
+
+  auto [Offset, Mask] = getSlice(N);
+  for (size_t i = 0; i <= Mask; i++) {
+    if (auto Value = ReadSlice(i); Value != Values[Offset + i]) {
+      return mismatch("read_slice", i, Value, Values[Offset + i]);
+    }
+  }
+
+  if (N >= kLanes) {
+    auto *ReadV4 = lookup<void (*)(uint64_t, uint32_t *)>(**J, "read_v4");
+    if (!ReadV4) {
+      return "missing read function";
+    }
+    for (size_t i = 0; i + kLanes <= N; i++) {
+      uint32_t Lanes[kLanes];
+      ReadV4(i, Lanes);
+      for (unsigned k = 0; k < kLanes; k++) {
+        if (Lanes[k] != Values[i + k]) {
+          return mismatch("read_v4", i + k, Lanes[k], Values[i + k]);
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> Copied(N);
+  Copy(Copied.data());
+  for (size_t i = 0; i < N; i++) {
+    if (Copied[i] != Values[i]) {
+      return mismatch("copy", i, Copied[i], Values[i]);
+    }
+  }
+
+  // Every element read above except those of the hot read is a lookup.
+  if (Spec.Instrument && Rewritten) {
+    uint64_t Expected = (Spec.Hot ? 0 : N) + Mask + 1 + N;
+    if (N >= kLanes) {
+      Expected += kLanes * (N - kLanes + 1);
+    }
+    // Ranges of one table count into the same record.
+    if (Records.size() != 1) {
+      return ("registered " + Twine(Records.size()) + " records, expected 1")
+          .str();
+    }
+    uint64_t Lookups = Records[0]->Lookups, Samples = Records[0]->Samples;
+    if (Lookups != Expected) {
+      return ("counted " + Twine(Lookups) + " lookups, expected " +
+              Twine(Expected))
+          .str();
+    }
+    if ((Samples > 0) != (Spec.SamplePeriod > 0) || Samples > Lookups) {
+      return ("sampled " + Twine(Samples) + " of " + Twine(Lookups) +
+              " lookups with period " + Twine(Spec.SamplePeriod))
+          .str();
+    }
+  }
+
+  return verifyConstexpr(Spec, Points);
+}
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  bool Rewritten;
+  auto Error = verifyTable(decodeSpec(Data, Size), Rewritten);
+  if (!Error.empty()) {
+    errs() << Error << "\n";
+    abort();
+  }
+  return 0;
+}
+
+#ifndef INTERPOLATE_LIBFUZZER
+static cl::opt<unsigned> Tables("tables",
+                                cl::desc("Number of random tables to check"),
+                                cl::init(1000));
+static cl::opt<unsigned> Jobs("j", cl::desc("Threads, 0 for one per core"),
+                              cl::init(0));
+static cl::opt<uint64_t> Seed("seed", cl::desc("Seed of the first table"),
+                              cl::init(1));
+static cl::opt<bool> Verbose("verbose", cl::desc("Show the pass's messages"),
+                             cl::init(false));
+
+// Seed of the table each thread is checking, to report if the pass crashes
+// while its messages are hidden.
+static constexpr uint64_t kIdle = ~0ull;
+static std::unique_ptr<std::atomic<uint64_t>[]> InFlight;
+static unsigned NumInFlight;
+
+static void reportInFlight(void *) {
+  for (unsigned i = 0; i < NumInFlight; i++) {
+    if (auto Seed = InFlight[i].load(); Seed != kIdle) {
+      outs() << "CRASH while checking seed " << Seed << "\n";
+    }
+  }
+  outs().flush();
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Interpolation verifier\n");
+  LLVMFuzzerInitialize(&argc, &argv);
+  if (!Verbose) {
+    dup2(open("/dev/null", O_WRONLY), STDERR_FILENO);
+  }
+
+  unsigned Threads =
+      Jobs ? Jobs : std::max(std::thread::hardware_concurrency(), 1u);
+  InFlight = std::make_unique<std::atomic<uint64_t>[]>(Threads);
+  NumInFlight = Threads;
+  for (unsigned i = 0; i < Threads; i++) {
+    InFlight[i] = kIdle;
+  }
+  sys::AddSignalHandler(reportInFlight, nullptr);
+  std::atomic<unsigned> Next(0), Failed(0), GF(0), Kept(0);
+  std::mutex OutputLock;
+  auto Start = std::chrono::steady_clock::now();
+
+  // Table k is decoded from random bytes seeded with Seed + k, so a failure
+  // is reproduced by -seed=<its seed> -tables=1.
+  auto Worker = [&](unsigned Thread) {
+    std::vector<uint8_t> Bytes(4 + 4 * kMaxSize);
+    for (unsigned k; (k = Next++) < Tables;) {
+      InFlight[Thread] = Seed + k;
+      std::mt19937_64 RNG(Seed + k);
+      for (auto &Byte : Bytes) {
+        Byte = RNG();
+      }
+      auto Spec = decodeSpec(Bytes.data(), Bytes.size());
+      bool Rewritten = false;
+      auto Error = verifyTable(Spec, Rewritten);
+      GF += Spec.Binary;
+      Kept += !Rewritten;
+      if (!Error.empty()) {
+        std::lock_guard<std::mutex> Lock(OutputLock);
+        outs() << "FAIL seed " << Seed + k << " ("
+               << (Spec.Binary ? "GF" : "prime")
+               << (Spec.PCLMUL ? ", pclmul" : "")
+               << (Spec.Instrument ? ", instrumented" : "")
+               << (Spec.Hot ? ", hot" : "") << ", "
+               << Spec.Values.size() << " entries): " << Error << "\n";
+        Failed++;
+      }
+    }
+    InFlight[Thread] = kIdle;
+  };
+  std::vector<std::thread> Pool;
+  for (unsigned i = 0; i < Threads; i++) {
+    Pool.emplace_back(Worker, i);
+  }
+  for (auto &T : Pool) {
+    T.join();
+  }
+
+  std::chrono::duration<double> Elapsed =
+      std::chrono::steady_clock::now() - Start;
+  outs() << "Checked " << Tables << " tables (" << GF << " over GF(2^k), "
+         << Kept << " left alone) on " << Threads << " threads in "
+         << format("%.2f", Elapsed.count()) << "s, "
+         << format("%.1f", Tables / Elapsed.count()) << " tables/s, "
+         << Failed << " failed.\n";
+  return Failed ? 1 : 0;
+}
+#endif
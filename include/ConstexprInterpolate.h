@@ -0,0 +1,150 @@
+#ifndef _CONSTEXPR_INTERPOLATE_H
+#define _CONSTEXPR_INTERPOLATE_H
+
+// Compile-time counterpart of Interpolate.cpp for code that can't be built
+// with the plugin. It picks the same prime as GetModulus and, since the
+// interpolating polynomial is unique, yields the same coefficients as
+// LagrangeInterpolate. Larger tables may need a raised constexpr budget
+// (-fconstexpr-steps for clang, -fconstexpr-ops-limit for gcc).
+//
+//   static constexpr std::array<uint32_t, 16> Table = {...};
+//   using Poly = interpolate::InterpolatedTable<Table>;
+//   static_assert(Poly::get(3) == Table[3]);
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace interpolate {
+
+constexpr int64_t MulMod(int64_t A, int64_t B, int64_t Modulus) {
+  return static_cast<int64_t>(static_cast<unsigned __int128>(A) * B %
+                              static_cast<uint64_t>(Modulus));
+}
+
+constexpr int64_t ModPow(int64_t Base, int64_t Exp, int64_t Modulus) {
+  Base %= Modulus;
+  int64_t Result = 1;
+  while (Exp > 0) {
+    if (Exp & 1)
+      Result = MulMod(Result, Base, Modulus);
+    Base = MulMod(Base, Base, Modulus);
+    Exp >>= 1;
+  }
+  return Result;
+}
+
+// Deterministic, unlike the Miller-Rabin test of the pass.
+constexpr bool IsPrime(int64_t Number) {
+  if (Number < 2)
+    return false;
+  for (int64_t D = 2; D * D <= Number; D++) {
+    if (Number % D == 0)
+      return false;
+  }
+  return true;
+}
+
+template <size_t N>
+constexpr int64_t GetModulus(const std::array<uint32_t, N> &Table) {
+  int64_t Modulus = N - 1;
+  for (auto Value : Table) {
+    Modulus = Value > Modulus ? Value : Modulus;
+  }
+  Modulus += 100;
+
+  // Find next prime
+  while (!IsPrime(Modulus)) {
+    Modulus += 1;
+  }
+  return Modulus;
+}
+
+template <size_t N> struct Polynomial {
+  std::array<int64_t, N> Coefficients;
+  int64_t Modulus;
+};
+
+// Lagrange interpolation of (i, Table[i]) in O(N^2): every basis polynomial
+// is L(x) / (x - j) for L(x) = x(x - 1)...(x - N + 1), and its value at j is
+// j! (N - 1 - j)! (-1)^(N - 1 - j).
+template <size_t N>
+constexpr Polynomial<N> Interpolate(const std::array<uint32_t, N> &Table) {
+  static_assert(N > 0, "Table must not be empty.");
+  Polynomial<N> Result{};
+  auto Modulus = GetModulus(Table);
+  Result.Modulus = Modulus;
+
+  std::array<int64_t, N + 1> Master{};
+  Master[0] = 1;
+  for (size_t i = 0; i < N; i++) {
+    for (size_t k = i + 1; k > 0; k--) {
+      Master[k] = (Master[k - 1] + MulMod(Master[k], Modulus - i, Modulus)) %
+                  Modulus;
+    }
+    Master[0] = MulMod(Master[0], Modulus - i, Modulus);
+  }
+
+  std::array<int64_t, N> Factorial{};
+  Factorial[0] = 1;
+  for (size_t i = 1; i < N; i++) {
+    Factorial[i] = MulMod(Factorial[i - 1], i, Modulus);
+  }
+
+  for (size_t j = 0; j < N; j++) {
+    auto Divisor = MulMod(Factorial[j], Factorial[N - 1 - j], Modulus);
+    if ((N - 1 - j) & 1) {
+      Divisor = (Modulus - Divisor) % Modulus;
+    }
+    auto Scale =
+        MulMod(Table[j], ModPow(Divisor, Modulus - 2, Modulus), Modulus);
+
+    int64_t Carry = 0;
+    for (size_t k = N; k > 0; k--) {
+      Carry = (Master[k] + MulMod(Carry, j, Modulus)) % Modulus;
+      Result.Coefficients[k - 1] =
+          (Result.Coefficients[k - 1] + MulMod(Carry, Scale, Modulus)) %
+          Modulus;
+    }
+  }
+  return Result;
+}
+
+// Horner evaluation of a polynomial of the given degree.
+template <int64_t Modulus, size_t Degree>
+constexpr uint32_t Evaluate(const std::array<int64_t, Degree + 1> &P,
+                            uint64_t X) {
+  auto Point = static_cast<int64_t>(X % Modulus);
+  int64_t Result = 0;
+  for (size_t i = Degree + 1; i > 0; i--) {
+    Result = (MulMod(Result, Point, Modulus) + P[i - 1]) % Modulus;
+  }
+  return static_cast<uint32_t>(Result);
+}
+
+// The same with the modulus known only at run time, for polynomials of
+// tables that are not constant expressions.
+template <size_t N>
+constexpr uint32_t Evaluate(const Polynomial<N> &P, uint64_t X) {
+  auto Point = static_cast<int64_t>(X % P.Modulus);
+  int64_t Result = 0;
+  for (size_t i = N; i > 0; i--) {
+    Result = (MulMod(Result, Point, P.Modulus) + P.Coefficients[i - 1]) %
+             P.Modulus;
+  }
+  return static_cast<uint32_t>(Result);
+}
+
+// A table replaced by its polynomial, computed once at compile time.
+template <const auto &Table> struct InterpolatedTable {
+  static constexpr size_t Size = Table.size();
+  static constexpr auto Poly = Interpolate(Table);
+
+  static constexpr uint32_t get(uint64_t Index) {
+    return Evaluate<Poly.Modulus, Size - 1>(Poly.Coefficients, Index);
+  }
+};
+
+} // namespace interpolate
+
+#endif
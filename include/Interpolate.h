@@ -12,6 +12,7 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 
+#include <llvm/Support/MathExtras.h>
 #include <llvm/Support/raw_ostream.h>
 
 using Point = std::pair<int64_t, int64_t>;
@@ -22,5 +23,8 @@ std::vector<Point> ExtractIndexValuePairs(const llvm::GlobalVariable &GV);
 bool IsPrime(int64_t Number, uint64_t K);
 void PolyPrint(const Poly &P);
 std::tuple<Poly, int64_t> LagrangeInterpolate(const std::vector<Point> &Points);
+bool IsGFRepresentable(const std::vector<Point> &Points);
+std::tuple<Poly, int64_t>
+GFLagrangeInterpolate(const std::vector<Point> &Points);
 
 #endif
\ No newline at end of file
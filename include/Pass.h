@@ -0,0 +1,25 @@
+#ifndef _PASS_H
+#define _PASS_H
+
+#include <llvm/IR/Module.h>
+
+// What a run of the pass does. The plugin fills it from its -interpolate-*
+// options; other users, like the verifier, pass their own.
+struct InterpolateOptions {
+  // Leave tables other modules can read for link time.
+  bool DeferExported = false;
+  // Count lookups, and time one in every SamplePeriod of them.
+  bool Instrument = false;
+  unsigned SamplePeriod = 0;
+  // Report what is done with every table, not only the skipped ones.
+  bool Verbose = false;
+  // Leave the reads profile data marks hot as loads.
+  bool KeepHot = true;
+  // Largest slice, in percent of the table, that gets its own polynomial.
+  unsigned MaxSlicePercent = 50;
+};
+
+// Interpolate the annotated tables of M, as the pass does.
+bool transformModule(llvm::Module &M, const InterpolateOptions &Options);
+
+#endif
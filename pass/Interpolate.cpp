@@ -2,8 +2,8 @@
 
 using namespace llvm;
 
-std::random_device RD;
-std::mt19937_64 RNG(RD());
+// Per thread, so that tables can be interpolated concurrently.
+thread_local std::mt19937_64 RNG(std::random_device{}());
 
 bool IsValid(const GlobalVariable &GV) {
   auto *Type = GV.getValueType();
@@ -35,28 +35,30 @@ std::vector<Point> ExtractIndexValuePairs(const GlobalVariable &GV) {
 
   auto *Type = dyn_cast<ArrayType>(GV.getValueType());
   auto Size = Type->getArrayNumElements();
-  auto *Init = dyn_cast<ConstantDataArray>(GV.getInitializer());
+  // Not necessarily a ConstantDataArray, all-zero tables are a
+  // ConstantAggregateZero.
+  auto *Init = GV.getInitializer();
 
-  assert(Init->getNumElements() == Size &&
-         "Initializer should always has the same number of elements as the "
-         "type does.");
-
-  for (unsigned Index = 0; Index < Init->getNumElements(); Index++) {
-    auto *ConstantValue =
-        dyn_cast<ConstantInt>(Init->getElementAsConstant(Index));
+  for (unsigned Index = 0; Index < Size; Index++) {
+    auto *ConstantValue = cast<ConstantInt>(Init->getAggregateElement(Index));
     int64_t Value = static_cast<int64_t>(ConstantValue->getZExtValue());
     Result.push_back(std::make_pair(Index, Value));
   }
   return Result;
 }
 
+// a * b % m for 0 <= a, b < m, without overflowing for moduli above 2^31.
+template <typename T> static T mulmod(T a, T b, T m) {
+  return static_cast<T>(static_cast<unsigned __int128>(a) * b % m);
+}
+
 template <typename T> static T modpow(T base, T exp, T modulus) {
   base %= modulus;
   T result = 1;
   while (exp > 0) {
     if (exp & 1)
-      result = (result * base) % modulus;
-    base = (base * base) % modulus;
+      result = mulmod(result, base, modulus);
+    base = mulmod(base, base, modulus);
     exp >>= 1;
   }
   return result;
@@ -107,7 +109,7 @@ static bool MillerRabin(int64_t D, int64_t N) {
     return true;
 
   while (D != N - 1) {
-    X = (X * X) % N;
+    X = mulmod(X, X, N);
     D <<= 1;
 
     if (X == 1)
@@ -140,13 +142,16 @@ bool IsPrime(int64_t Number, uint64_t K) {
 #pragma region Interpolation
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-function"
+// A prime above every value and every index, so that distinct indices stay
+// distinct points in the field.
 static int64_t GetModulus(const std::vector<Point> &Points) {
   auto max_iter = std::max_element(
-      Points.begin(), Points.end(),
-      [](const Point &a, const Point &b) { return a.second < b.second; });
+      Points.begin(), Points.end(), [](const Point &a, const Point &b) {
+        return std::max(a.first, a.second) < std::max(b.first, b.second);
+      });
 
   assert(max_iter != Points.end() && "Iterator went pass the vector.");
-  auto modulus = max_iter->second + 100;
+  auto modulus = std::max(max_iter->first, max_iter->second) + 100;
 
   // Find next prime
   while (true) {
@@ -191,7 +196,9 @@ static Poly PolyMult(const Poly &A, const Poly &B, uint64_t Modulus) {
   P.resize(newdeg + 1);
   for (size_t degA = 0; degA < A.size(); degA++) {
     for (size_t degB = 0; degB < B.size(); degB++) {
-      P[degA + degB] = (P[degA + degB] + A[degA] * B[degB]) % Modulus;
+      P[degA + degB] =
+          (P[degA + degB] + mulmod<uint64_t>(A[degA], B[degB], Modulus)) %
+          Modulus;
     }
   }
   return PolyRemoveLeadingZeroTerm(P);
@@ -207,7 +214,7 @@ static Poly LagrangeBasis(const std::vector<Point> &Points, int64_t J,
     if (Pt.first == J)
       continue;
     P = PolyMult(P, {mod(Modulus - Pt.first, Modulus), 1}, Modulus);
-    Divisor = (Divisor * mod(J - Pt.first, Modulus)) % Modulus;
+    Divisor = mulmod(Divisor, mod(J - Pt.first, Modulus), Modulus);
   }
 
   auto DivInv = inverse<int64_t>(Divisor, Modulus);
@@ -241,11 +248,125 @@ LagrangeInterpolate(const std::vector<Point> &Points) {
   Poly Polynomial;
 
   for (size_t i = 0; i < Points.size(); i++) {
-    Poly Basis = LagrangeBasis(Points, i, Modulus);
+    Poly Basis = LagrangeBasis(Points, Points[i].first, Modulus);
     Polynomial = PolyAdd(Polynomial,
                          PolyMult(Basis, {Points[i].second}, Modulus), Modulus);
   }
   return {Polynomial, Modulus};
 }
 #pragma GCC diagnostic pop
-#pragma endregion
\ No newline at end of file
+#pragma endregion
+
+#pragma region GF2
+// Interpolation over GF(2^k), the field of binary polynomials of degree < k
+// modulo an irreducible polynomial of degree k. Elements are stored as bit
+// vectors, addition is xor.
+static constexpr unsigned kMaxGFDegree = 16;
+
+static unsigned GFDegree(const std::vector<Point> &Points) {
+  int64_t Max = 1;
+  for (auto &Pt : Points) {
+    Max = std::max({Max, Pt.first, Pt.second});
+  }
+  return Log2_64(Max) + 1;
+}
+
+static int64_t GFReduce(int64_t A, int64_t Modulus) {
+  unsigned Degree = Log2_64(Modulus);
+  while (A != 0 && Log2_64(A) >= Degree) {
+    A ^= Modulus << (Log2_64(A) - Degree);
+  }
+  return A;
+}
+
+static bool IsIrreducible(int64_t P) {
+  unsigned Degree = Log2_64(P);
+  for (int64_t D = 2; D < (int64_t(1) << (Degree / 2 + 1)); D++) {
+    if (GFReduce(P, D) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The smallest irreducible polynomial of the given degree, which for k = 8
+// is the AES polynomial x^8 + x^4 + x^3 + x + 1.
+static int64_t GetIrreducible(unsigned Degree) {
+  int64_t P = (int64_t(1) << Degree) | 1;
+  while (!IsIrreducible(P)) {
+    P += 2;
+  }
+  return P;
+}
+
+static int64_t GFMult(int64_t A, int64_t B, int64_t Modulus) {
+  int64_t HighBit = int64_t(1) << (Log2_64(Modulus) - 1);
+  int64_t Result = 0;
+  while (B != 0) {
+    if (B & 1)
+      Result ^= A;
+    bool Carry = A & HighBit;
+    A = (A << 1) & ((HighBit << 1) - 1);
+    if (Carry)
+      A ^= Modulus & ((HighBit << 1) - 1);
+    B >>= 1;
+  }
+  return Result;
+}
+
+static int64_t GFInverse(int64_t A, int64_t Modulus) {
+  assert(A != 0 && "Multiplicative inverse does not exist.");
+  // A^(2^k - 2)
+  int64_t Exp = (int64_t(1) << Log2_64(Modulus)) - 2;
+  int64_t Result = 1;
+  while (Exp > 0) {
+    if (Exp & 1)
+      Result = GFMult(Result, A, Modulus);
+    A = GFMult(A, A, Modulus);
+    Exp >>= 1;
+  }
+  return Result;
+}
+
+bool IsGFRepresentable(const std::vector<Point> &Points) {
+  return GFDegree(Points) <= kMaxGFDegree;
+}
+
+std::tuple<Poly, int64_t>
+GFLagrangeInterpolate(const std::vector<Point> &Points) {
+  assert(IsGFRepresentable(Points) && "Points do not fit in GF(2^k).");
+  auto Modulus = GetIrreducible(GFDegree(Points));
+
+  // L(x) = (x + x_0)(x + x_1)...(x + x_n-1)
+  Poly Master = {1};
+  for (auto &Pt : Points) {
+    Poly Next(Master.size() + 1, 0);
+    for (size_t i = 0; i < Master.size(); i++) {
+      Next[i + 1] ^= Master[i];
+      Next[i] ^= GFMult(Master[i], Pt.first, Modulus);
+    }
+    Master = Next;
+  }
+
+  // Each basis is L(x) / (x + x_j), scaled by y_j / prod(x_j + x_m).
+  Poly Polynomial(Points.size(), 0);
+  for (auto &Pt : Points) {
+    Poly Basis(Points.size(), 0);
+    int64_t Carry = 0;
+    for (size_t i = Points.size(); i > 0; i--) {
+      Carry = Master[i] ^ GFMult(Carry, Pt.first, Modulus);
+      Basis[i - 1] = Carry;
+    }
+
+    int64_t Divisor = 0;
+    for (size_t i = Basis.size(); i > 0; i--) {
+      Divisor = GFMult(Divisor, Pt.first, Modulus) ^ Basis[i - 1];
+    }
+    auto Scale = GFMult(Pt.second, GFInverse(Divisor, Modulus), Modulus);
+    for (size_t i = 0; i < Basis.size(); i++) {
+      Polynomial[i] ^= GFMult(Basis[i], Scale, Modulus);
+    }
+  }
+  return {PolyRemoveLeadingZeroTerm(Polynomial), Modulus};
+}
+#pragma endregion
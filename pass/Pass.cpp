@@ -1,17 +1,39 @@
 #include <llvm/Pass.h>
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/Triple.h>
+
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/BlockFrequencyInfo.h>
+#include <llvm/Analysis/BranchProbabilityInfo.h>
+#include <llvm/Analysis/LazyValueInfo.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Analysis/ValueTracking.h>
+
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
 #include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
+#include <llvm/IR/ConstantRange.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
 #include <llvm/IR/GlobalObject.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/IntrinsicsX86.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
 
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/KnownBits.h>
 #include <llvm/Support/raw_ostream.h>
 
 #if LLVM_VERSION_MAJOR >= 13
@@ -24,43 +46,292 @@
 using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
 #endif
 #endif
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 
 #include "Compile.h"
 #include "Interpolate.h"
+#include "Pass.h"
 
 using namespace llvm;
 
-static FunctionCallee getModPowFunction(Module &M) {
+static cl::opt<bool> Instrument(
+    "interpolate-instrument",
+    cl::desc("Count the lookups of each interpolated table and report them at "
+             "exit (needs runtime/profile.c)"),
+    cl::init(false));
+static cl::opt<unsigned> SamplePeriod(
+    "interpolate-sample-period",
+    cl::desc("Time one in every N instrumented lookups with the cycle counter "
+             "(0 disables timing)"),
+    cl::init(0));
+static cl::opt<bool> Verbose(
+    "interpolate-verbose",
+    cl::desc("Report what is done with every table, not only the skipped "
+             "ones"),
+    cl::init(false));
+static cl::opt<unsigned> MaxSlicePercent(
+    "interpolate-max-slice-percent",
+    cl::desc("Give reads reaching at most this percentage of a table the "
+             "polynomial through their slice only"),
+    cl::init(50));
+static cl::opt<bool> DeferLTO(
+    "interpolate-defer-lto",
+    cl::desc("Leave tables other modules can read for the link-time run "
+             "(the link must load the plugin too)"),
+    cl::init(false));
+static cl::opt<bool> KeepHot(
+    "interpolate-keep-hot",
+    cl::desc("Leave the table reads that profile data marks hot as loads"),
+    cl::init(true));
+
+// The field a table is interpolated over, picked by its annotation:
+// "interpolate" for a prime field, "interpolate_gf" for GF(2^k).
+enum class Field { Prime, Binary };
+
+// A distinct table and the polynomial functions built for it, by vector width
+// (1 for the scalar one). Tables with byte-identical contents share an entry.
+// For binary fields, Modulus is the irreducible polynomial.
+struct TablePolynomial {
+  std::string Name;
+  Field Kind;
+  Poly P;
+  int64_t Modulus;
+  DenseMap<unsigned, Function *> Functions;
+};
+
+using TableKey = std::pair<Field, std::vector<Point>>;
+struct TableKeyHash {
+  size_t operator()(const TableKey &Key) const {
+    return hash_combine(
+        Key.first, hash_combine_range(Key.second.begin(), Key.second.end()));
+  }
+};
+using PolyCache = std::unordered_map<TableKey, TablePolynomial, TableKeyHash>;
+
+static Type *getLaneType(Type *ScalarType, unsigned Lanes) {
+  if (Lanes == 1) {
+    return ScalarType;
+  }
+  return FixedVectorType::get(ScalarType, Lanes);
+}
+
+static std::string getLaneSuffix(unsigned Lanes) {
+  return Lanes == 1 ? "" : "_v" + std::to_string(Lanes);
+}
+
+// Emit (or reuse) a square-and-multiply function `Name(base, exp)` over
+// BaseType, where Mult multiplies two elements inside the function.
+// Vector variants raise every lane of the base to the same scalar exponent.
+static FunctionCallee getPowFunction(
+    Module &M, const std::string &Name, Type *BaseType, Constant *One,
+    function_ref<Value *(IRBuilder<> &, Value *, Value *)> Mult) {
   auto *I64Type = IntegerType::get(M.getContext(), 64);
-  auto *FuncType =
-      FunctionType::get(I64Type, {I64Type, I64Type, I64Type}, false);
-  return M.getOrInsertFunction("modpow", FuncType);
+  auto *FuncType = FunctionType::get(BaseType, {BaseType, I64Type}, false);
+  if (auto *F = M.getFunction(Name)) {
+    return FunctionCallee(FuncType, F);
+  }
+
+  auto *F = Function::Create(
+      FuncType, GlobalValue::LinkageTypes::PrivateLinkage, Name, M);
+  auto *Entry = BasicBlock::Create(M.getContext(), "entry", F);
+  auto *Loop = BasicBlock::Create(M.getContext(), "loop", F);
+  auto *Body = BasicBlock::Create(M.getContext(), "body", F);
+  auto *Exit = BasicBlock::Create(M.getContext(), "exit", F);
+  IRBuilder<> IRB(Entry);
+  IRB.CreateBr(Loop);
+
+  // while (x > 0)
+  IRB.SetInsertPoint(Loop);
+  auto *Result = IRB.CreatePHI(BaseType, 2, "result");
+  auto *Base = IRB.CreatePHI(BaseType, 2, "a");
+  auto *Exp = IRB.CreatePHI(I64Type, 2, "x");
+  IRB.CreateCondBr(IRB.CreateICmpSGT(Exp, ConstantInt::get(I64Type, 0)), Body,
+                   Exit);
+
+  // if (x & 1) result = result * a; a = a * a; x >>= 1;
+  IRB.SetInsertPoint(Body);
+  auto *Odd = IRB.CreateTrunc(Exp, IntegerType::get(M.getContext(), 1));
+  auto *NextResult = IRB.CreateSelect(Odd, Mult(IRB, Result, Base), Result);
+  auto *NextBase = Mult(IRB, Base, Base);
+  auto *NextExp = IRB.CreateAShr(Exp, 1);
+  IRB.CreateBr(Loop);
+
+  Result->addIncoming(One, Entry);
+  Result->addIncoming(NextResult, Body);
+  Base->addIncoming(F->getArg(0), Entry);
+  Base->addIncoming(NextBase, Body);
+  Exp->addIncoming(F->getArg(1), Entry);
+  Exp->addIncoming(NextExp, Body);
+
+  IRB.SetInsertPoint(Exit);
+  IRB.CreateRet(Result);
+  return FunctionCallee(FuncType, F);
+}
+
+// Whether a sum of Terms products of two residues may overflow an i64, in
+// which case the arithmetic is done in i128.
+static bool needsWideArithmetic(int64_t Modulus, size_t Terms) {
+  auto Max = static_cast<unsigned __int128>(Modulus - 1);
+  return Max * Max * std::max<size_t>(Terms, 1) > INT64_MAX;
+}
+
+// Emit (or reuse) `modpow_<Modulus>`, square-and-multiply with the modulus
+// folded in, so that the remainders lower to constant divisions.
+static FunctionCallee getModPowFunction(Module &M, int64_t Modulus,
+                                        unsigned Lanes) {
+  auto *BaseType = getLaneType(IntegerType::get(M.getContext(), 64), Lanes);
+  auto *WideType = getLaneType(IntegerType::get(M.getContext(), 128), Lanes);
+  bool Wide = needsWideArithmetic(Modulus, 1);
+  auto *ModulusValue = ConstantInt::get(Wide ? WideType : BaseType, Modulus);
+  return getPowFunction(
+      M, "modpow_" + std::to_string(Modulus) + getLaneSuffix(Lanes), BaseType,
+      ConstantInt::get(BaseType, 1),
+      [&](IRBuilder<> &IRB, Value *A, Value *B) -> Value * {
+        if (!Wide) {
+          return IRB.CreateSRem(IRB.CreateMul(A, B), ModulusValue);
+        }
+        auto *Product = IRB.CreateMul(IRB.CreateZExt(A, WideType),
+                                      IRB.CreateZExt(B, WideType));
+        return IRB.CreateTrunc(IRB.CreateURem(Product, ModulusValue),
+                               BaseType);
+      });
+}
+
+// Check if the code being compiled may use pclmulqdq, i.e. every function
+// carrying target features (and there is at least one) enables it.
+static bool hasPCLMUL(const Module &M) {
+  if (!Triple(M.getTargetTriple()).isX86()) {
+    return false;
+  }
+  bool Found = false;
+  for (auto &F : M) {
+    auto Features = F.getFnAttribute("target-features");
+    if (!Features.isValid()) {
+      continue;
+    }
+    if (!Features.getValueAsString().contains("+pclmul")) {
+      return false;
+    }
+    Found = true;
+  }
+  return Found;
+}
+
+// Reduce a carry-less product of two elements modulo the irreducible
+// polynomial, from the highest possible bit down to x^k.
+static Value *emitGFReduce(IRBuilder<> &IRB, Value *Product, int64_t Modulus) {
+  unsigned Degree = Log2_64(Modulus);
+  auto *Type = Product->getType();
+  for (unsigned i = 2 * Degree - 2; i >= Degree; i--) {
+    auto *Bit = IRB.CreateAnd(IRB.CreateLShr(Product, i), 1);
+    auto *Mask = IRB.CreateNeg(Bit);
+    Product = IRB.CreateXor(
+        Product,
+        IRB.CreateAnd(Mask, ConstantInt::get(Type, Modulus << (i - Degree))));
+  }
+  return Product;
+}
+
+// Emit (or reuse) `gfmul_<Modulus>`, multiplication in GF(2^k). It uses
+// pclmulqdq for the carry-less product where available, and a branch-free
+// shift/xor loop (unrolled k times) otherwise.
+static FunctionCallee getGFMulFunction(Module &M, int64_t Modulus,
+                                       unsigned Lanes) {
+  std::string Name =
+      "gfmul_" + std::to_string(Modulus) + getLaneSuffix(Lanes);
+  auto *I32Type = getLaneType(IntegerType::get(M.getContext(), 32), Lanes);
+  auto *FuncType = FunctionType::get(I32Type, {I32Type, I32Type}, false);
+  if (auto *F = M.getFunction(Name)) {
+    return FunctionCallee(FuncType, F);
+  }
+
+  auto *F = Function::Create(
+      FuncType, GlobalValue::LinkageTypes::PrivateLinkage, Name, M);
+  auto *BB = BasicBlock::Create(M.getContext(), "entry", F);
+  IRBuilder<> IRB(BB);
+  unsigned Degree = Log2_64(Modulus);
+  Value *A = F->getArg(0);
+  Value *B = F->getArg(1);
+
+  if (Lanes == 1 && hasPCLMUL(M)) {
+    F->addFnAttr("target-features", "+pclmul");
+    auto *I64Type = IRB.getInt64Ty();
+    auto *VecType = FixedVectorType::get(I64Type, 2);
+    auto *Zero = ConstantAggregateZero::get(VecType);
+    auto *VA = IRB.CreateInsertElement(Zero, IRB.CreateZExt(A, I64Type),
+                                       uint64_t(0));
+    auto *VB = IRB.CreateInsertElement(Zero, IRB.CreateZExt(B, I64Type),
+                                       uint64_t(0));
+    auto *CLMul = IRB.CreateCall(
+        Intrinsic::getDeclaration(&M, Intrinsic::x86_pclmulqdq),
+        {VA, VB, IRB.getInt8(0)});
+    auto *Product = IRB.CreateExtractElement(CLMul, uint64_t(0));
+    IRB.CreateRet(
+        IRB.CreateTrunc(emitGFReduce(IRB, Product, Modulus), I32Type));
+    return FunctionCallee(FuncType, F);
+  }
+
+  // for each bit of b: if (b & 1) r ^= a; a = xtime(a); b >>= 1;
+  Value *Result = ConstantInt::get(I32Type, 0);
+  for (unsigned i = 0; i < Degree; i++) {
+    auto *Bit = IRB.CreateAnd(IRB.CreateLShr(B, i), 1);
+    Result = IRB.CreateXor(Result, IRB.CreateAnd(A, IRB.CreateNeg(Bit)));
+    if (i + 1 < Degree) {
+      auto *Carry = IRB.CreateAnd(IRB.CreateLShr(A, Degree - 1), 1);
+      A = IRB.CreateXor(IRB.CreateShl(A, 1),
+                        IRB.CreateAnd(IRB.CreateNeg(Carry),
+                                      ConstantInt::get(I32Type, Modulus)));
+    }
+  }
+  IRB.CreateRet(Result);
+  return FunctionCallee(FuncType, F);
+}
+
+static FunctionCallee getGFPowFunction(Module &M, int64_t Modulus,
+                                       unsigned Lanes) {
+  auto *BaseType = getLaneType(IntegerType::get(M.getContext(), 32), Lanes);
+  auto GFMul = getGFMulFunction(M, Modulus, Lanes);
+  return getPowFunction(
+      M, "gfpow_" + std::to_string(Modulus) + getLaneSuffix(Lanes), BaseType,
+      ConstantInt::get(BaseType, 1),
+      [&](IRBuilder<> &IRB, Value *A, Value *B) {
+        return IRB.CreateCall(GFMul, {A, B});
+      });
 }
 
 Function *buildPolynomialFunction(Module &M, StringRef VariableName,
-                                  const Poly &P, int64_t Modulus) {
-  auto *I32Type = IntegerType::get(M.getContext(), 32);
-  auto *I64Type = IntegerType::get(M.getContext(), 64);
+                                  const Poly &P, int64_t Modulus,
+                                  unsigned Lanes) {
+  auto *I32Type = getLaneType(IntegerType::get(M.getContext(), 32), Lanes);
+  auto *I64Type = getLaneType(IntegerType::get(M.getContext(), 64), Lanes);
+  auto *ExpType = IntegerType::get(M.getContext(), 64);
   auto *F = Function::Create(FunctionType::get(I32Type, {I64Type}, false),
                              GlobalValue::LinkageTypes::PrivateLinkage,
-                             "poly_" + VariableName, M);
+                             "poly_" + VariableName + getLaneSuffix(Lanes), M);
   auto *BB = BasicBlock::Create(M.getContext(), "entry", F);
   IRBuilder<> IRB(BB);
 
-  auto Callee = getModPowFunction(M);
+  auto Callee = getModPowFunction(M, Modulus, Lanes);
   auto *Arg = F->getArg(0);
 
+  // The monomials are summed before reducing, widen if that may overflow.
+  auto *SumType = needsWideArithmetic(Modulus, P.size())
+                      ? getLaneType(IntegerType::get(M.getContext(), 128),
+                                    Lanes)
+                      : I64Type;
+
   // Calculate monomial terms.
   std::vector<Value *> Monomials;
   for (size_t i = 0; i < P.size(); i++) {
     Value *V = nullptr;
     if (i == 0) {
-      V = ConstantInt::get(I64Type, P[0]);
+      V = ConstantInt::get(SumType, P[0]);
     } else {
-      V = IRB.CreateCall(Callee, {Arg, ConstantInt::get(I64Type, i),
-                                  ConstantInt::get(I64Type, Modulus)});
-      V = IRB.CreateMul(V, ConstantInt::get(I64Type, P[i]));
+      V = IRB.CreateCall(Callee, {Arg, ConstantInt::get(ExpType, i)});
+      V = IRB.CreateMul(IRB.CreateZExt(V, SumType),
+                        ConstantInt::get(SumType, P[i]));
     }
     Monomials.push_back(V);
   }
@@ -70,7 +341,7 @@ Function *buildPolynomialFunction(Module &M, StringRef VariableName,
   for (size_t i = 1; i < P.size(); i++) {
     Result = IRB.CreateAdd(Result, Monomials[i]);
   }
-  Result = IRB.CreateURem(Result, ConstantInt::get(I64Type, Modulus));
+  Result = IRB.CreateURem(Result, ConstantInt::get(SumType, Modulus));
 
   // Extract and return.
   auto *RetVal = IRB.CreateTrunc(Result, I32Type);
@@ -78,146 +349,705 @@ Function *buildPolynomialFunction(Module &M, StringRef VariableName,
   return F;
 }
 
-static void rewriteLoadInst(GlobalVariable &GV, Function *Polynomial) {
-  FunctionCallee Callee(Polynomial->getFunctionType(), Polynomial);
-  std::vector<std::pair<LoadInst *, Value *>> LoadInsts;
-  std::vector<GetElementPtrInst *> GEPInsts;
+// Same as buildPolynomialFunction over GF(2^k): the sum of the monomials
+// with non-zero coefficients is their xor.
+Function *buildGFPolynomialFunction(Module &M, StringRef VariableName,
+                                    const Poly &P, int64_t Modulus,
+                                    unsigned Lanes) {
+  auto *I32Type = getLaneType(IntegerType::get(M.getContext(), 32), Lanes);
+  auto *I64Type = getLaneType(IntegerType::get(M.getContext(), 64), Lanes);
+  auto *ExpType = IntegerType::get(M.getContext(), 64);
+  auto *F = Function::Create(FunctionType::get(I32Type, {I64Type}, false),
+                             GlobalValue::LinkageTypes::PrivateLinkage,
+                             "poly_" + VariableName + getLaneSuffix(Lanes), M);
+  auto *BB = BasicBlock::Create(M.getContext(), "entry", F);
+  IRBuilder<> IRB(BB);
+
+  auto GFMul = getGFMulFunction(M, Modulus, Lanes);
+  auto GFPow = getGFPowFunction(M, Modulus, Lanes);
+  auto *Arg = IRB.CreateTrunc(F->getArg(0), I32Type);
+
+  Value *Result = ConstantInt::get(I32Type, P[0]);
+  for (size_t i = 1; i < P.size(); i++) {
+    if (P[i] == 0) {
+      continue;
+    }
+    Value *V = IRB.CreateCall(GFPow, {Arg, ConstantInt::get(ExpType, i)});
+    if (P[i] != 1) {
+      V = IRB.CreateCall(GFMul, {V, ConstantInt::get(I32Type, P[i])});
+    }
+    Result = IRB.CreateXor(Result, V);
+  }
+  IRB.CreateRet(Result);
+  return F;
+}
+
+#pragma region profile
+// Fields of struct interpolate_record in runtime/profile.c.
+enum RecordField {
+  RecordName,
+  RecordLookups,
+  RecordCycles,
+  RecordSamples,
+  RecordPowers,
+  RecordNext
+};
 
-  for (auto *U : GV.users()) {
-    if (auto *GEPInst = dyn_cast<GetElementPtrInst>(U)) {
-      auto *Index = GEPInst->getOperand(2);
-      for (auto *User : GEPInst->users()) {
-        auto *LI = dyn_cast<LoadInst>(User);
-        LoadInsts.push_back({LI, Index});
+// Exponentiations per lookup, a rough static cost of the polynomial.
+static uint64_t countPowers(const TablePolynomial &TP) {
+  if (TP.Kind == Field::Prime) {
+    return TP.P.size() - 1;
+  }
+  return std::count_if(TP.P.begin() + 1, TP.P.end(),
+                       [](int64_t C) { return C != 0; });
+}
+
+// The counters of one annotated table, and its instrumented wrappers by the
+// polynomial function they call. Identical tables and ranges share the
+// polynomial functions, but each table counts its own lookups.
+struct TableProfile {
+  GlobalVariable *Record = nullptr;
+  DenseMap<Function *, Function *> Wrappers;
+};
+
+// Create the counters of a table, registered with the runtime by a module
+// constructor. Read through several ranges, the table reports the powers of
+// the costliest.
+static GlobalVariable *getProfileRecord(Module &M, const GlobalVariable &GV,
+                                        TableProfile &Profile,
+                                        const TablePolynomial &TP) {
+  auto *Powers = ConstantInt::get(Type::getInt64Ty(M.getContext()),
+                                  countPowers(TP));
+  if (auto *Record = Profile.Record) {
+    auto *Init = cast<ConstantStruct>(Record->getInitializer());
+    if (cast<ConstantInt>(Init->getOperand(RecordPowers))->getZExtValue() <
+        Powers->getZExtValue()) {
+      SmallVector<Constant *, 6> Fields;
+      for (auto &Op : Init->operands()) {
+        Fields.push_back(cast<Constant>(Op));
       }
-      GEPInsts.push_back(GEPInst);
-    } else if (auto *GEPOp = dyn_cast<GEPOperator>(U)) {
-      auto *Index = GEPOp->getOperand(2);
-      auto *LI = dyn_cast<LoadInst>(GEPOp->user_back());
-      LoadInsts.push_back({LI, Index});
-    } else if (auto *CastOp = dyn_cast<BitCastOperator>(U)) {
-      continue; // Annotation
-    } else {
-      llvm_unreachable("unhandled use");
+      Fields[RecordPowers] = Powers;
+      Record->setInitializer(ConstantStruct::get(Init->getType(), Fields));
     }
+    return Record;
+  }
+  auto &Ctx = M.getContext();
+  auto *I8PtrType = Type::getInt8PtrTy(Ctx);
+  auto *I64Type = Type::getInt64Ty(Ctx);
+  auto *RecordType = StructType::getTypeByName(Ctx, "interpolate_record");
+  if (!RecordType) {
+    RecordType = StructType::create(
+        {I8PtrType, I64Type, I64Type, I64Type, I64Type, I8PtrType},
+        "interpolate_record");
   }
 
-  // Replace each LoadInst with CallInst
-  for (auto [LI, Index] : LoadInsts) {
-    auto *CI = CallInst::Create(Callee, {Index});
-    ReplaceInstWithInst(LI, CI);
+  IRBuilder<> IRB(Ctx);
+  auto *Name =
+      IRB.CreateGlobalStringPtr(GV.getName(), "interpolate_name", 0, &M);
+  auto *Zero = ConstantInt::get(I64Type, 0);
+  Profile.Record = new GlobalVariable(
+      M, RecordType, false, GlobalValue::LinkageTypes::PrivateLinkage,
+      ConstantStruct::get(RecordType, {Name, Zero, Zero, Zero, Powers,
+                                       Constant::getNullValue(I8PtrType)}),
+      "interpolate_record_" + GV.getName());
+
+  auto *Ctor = M.getFunction("interpolate_register_records");
+  if (!Ctor) {
+    Ctor = Function::Create(
+        FunctionType::get(Type::getVoidTy(Ctx), false),
+        GlobalValue::LinkageTypes::InternalLinkage,
+        "interpolate_register_records", M);
+    ReturnInst::Create(Ctx, BasicBlock::Create(Ctx, "entry", Ctor));
+    appendToGlobalCtors(M, Ctor, 65535);
   }
+  auto Register = M.getOrInsertFunction(
+      "__interpolate_register", Type::getVoidTy(Ctx), I8PtrType);
+  IRB.SetInsertPoint(Ctor->getEntryBlock().getTerminator());
+  IRB.CreateCall(Register, {IRB.CreateBitCast(Profile.Record, I8PtrType)});
+  return Profile.Record;
+}
+
+// Wrap F, a polynomial function of TP, in a function that adds the lanes it
+// reads to the lookup counter of GV and, once every SamplePeriod lookups,
+// times F with the cycle counter. Both counters are relaxed atomics.
+static Function *getInstrumentedFunction(Module &M, const GlobalVariable &GV,
+                                         TableProfile &Profile,
+                                         const TablePolynomial &TP,
+                                         Function *F, unsigned Lanes,
+                                         const InterpolateOptions &Options) {
+  auto &Wrapper = Profile.Wrappers[F];
+  if (Wrapper) {
+    return Wrapper;
+  }
+  auto *Record = getProfileRecord(M, GV, Profile, TP);
+  auto &Ctx = M.getContext();
+  auto *I64Type = Type::getInt64Ty(Ctx);
+  Wrapper = Function::Create(F->getFunctionType(),
+                             GlobalValue::LinkageTypes::PrivateLinkage,
+                             F->getName() + "." + GV.getName(), M);
+  IRBuilder<> IRB(BasicBlock::Create(Ctx, "entry", Wrapper));
 
-  // Remove redundant GEPInst
-  for (auto *GEPInst : GEPInsts) {
-    GEPInst->eraseFromParent();
+  auto AddTo = [&](RecordField Field, Value *V) {
+    auto *Ptr = IRB.CreateConstInBoundsGEP2_32(Record->getValueType(), Record,
+                                               0, Field);
+    return IRB.CreateAtomicRMW(AtomicRMWInst::Add, Ptr, V, MaybeAlign(8),
+                               AtomicOrdering::Monotonic);
+  };
+  auto *LanesValue = ConstantInt::get(I64Type, Lanes);
+  auto *Count = AddTo(RecordLookups, LanesValue);
+  auto *Arg = Wrapper->getArg(0);
+  if (Options.SamplePeriod == 0) {
+    IRB.CreateRet(IRB.CreateCall(F, {Arg}));
+    return Wrapper;
   }
-  return;
+
+  auto *Fast = BasicBlock::Create(Ctx, "fast", Wrapper);
+  auto *Timed = BasicBlock::Create(Ctx, "timed", Wrapper);
+  auto *Phase =
+      IRB.CreateURem(Count, ConstantInt::get(I64Type, Options.SamplePeriod));
+  IRB.CreateCondBr(IRB.CreateICmpULT(Phase, LanesValue), Timed, Fast,
+                   MDBuilder(Ctx).createBranchWeights(1, Options.SamplePeriod));
+
+  IRB.SetInsertPoint(Fast);
+  IRB.CreateRet(IRB.CreateCall(F, {Arg}));
+
+  IRB.SetInsertPoint(Timed);
+  auto *ReadCycles =
+      Intrinsic::getDeclaration(&M, Intrinsic::readcyclecounter);
+  auto *Start = IRB.CreateCall(ReadCycles);
+  auto *Result = IRB.CreateCall(F, {Arg});
+  auto *End = IRB.CreateCall(ReadCycles);
+  AddTo(RecordCycles, IRB.CreateSub(End, Start));
+  AddTo(RecordSamples, LanesValue);
+  IRB.CreateRet(Result);
+  return Wrapper;
 }
+#pragma endregion
 
-static bool handleRewrite(Module &M, GlobalVariable &GV) {
-  // Collect all possible rewrites, bailout if there's no rule
-  // to rewrite.
-  for (auto *U : GV.users()) {
-    if (auto *GEPInst = dyn_cast<GetElementPtrInst>(U)) {
-      // Check if it has two indices and if the first index is 0
-      if (GEPInst->getNumOperands() != 3) {
+static Function *getPolynomialFunction(Module &M, TablePolynomial &TP,
+                                       unsigned Lanes) {
+  auto &F = TP.Functions[Lanes];
+  if (F) {
+    return F;
+  }
+  if (TP.Kind == Field::Binary) {
+    F = buildGFPolynomialFunction(M, TP.Name, TP.P, TP.Modulus, Lanes);
+  } else {
+    F = buildPolynomialFunction(M, TP.Name, TP.P, TP.Modulus, Lanes);
+  }
+  return F;
+}
+
+// Pointers derived from a table, and the loads and memcpys reading the table
+// through them. Kept are the reads left as they are, Compared the pointers
+// compared against, e.g. by a loop running to the end of the table.
+struct TableAccesses {
+  SmallVector<Value *, 16> Pointers;
+  SmallVector<Instruction *, 16> Accesses;
+  SmallVector<Instruction *, 4> Kept;
+  SmallVector<Value *, 4> Compared;
+};
+
+// Check if U is an entry of llvm.global.annotations.
+static bool isAnnotationUse(User *U) {
+  auto *AnnoStruct = dyn_cast<ConstantStruct>(U);
+  if (!AnnoStruct || !AnnoStruct->hasOneUser()) {
+    return false;
+  }
+  auto *AnnoArray = dyn_cast<ConstantArray>(AnnoStruct->user_back());
+  if (!AnnoArray || !AnnoArray->hasOneUser()) {
+    return false;
+  }
+  auto *GVar = dyn_cast<GlobalVariable>(AnnoArray->user_back());
+  return GVar && GVar->getName() == "llvm.global.annotations";
+}
+
+// Check that the GEP moves its base by whole table elements, so that every
+// derived pointer points at the start of an element.
+static bool isElementAligned(GEPOperator *GEP, const DataLayout &DL,
+                             uint64_t ElemSize) {
+  uint64_t ConstOffset = 0;
+  unsigned TrailingZeros = countTrailingZeros(ElemSize);
+  auto GTI = gep_type_begin(GEP);
+  for (auto *I = GEP->idx_begin(); I != GEP->idx_end(); I++, GTI++) {
+    if (auto *STy = GTI.getStructTypeOrNull()) {
+      auto FieldNo = cast<ConstantInt>(*I)->getZExtValue();
+      ConstOffset += DL.getStructLayout(STy)->getElementOffset(FieldNo);
+      continue;
+    }
+    uint64_t Stride = DL.getTypeAllocSize(GTI.getIndexedType());
+    if (auto *CI = dyn_cast<ConstantInt>(*I)) {
+      ConstOffset += CI->getSExtValue() * Stride;
+    } else {
+      auto Known = computeKnownBits(*I, DL);
+      if (countTrailingZeros(Stride) + Known.countMinTrailingZeros() <
+          TrailingZeros) {
         return false;
       }
-      if (auto *IDX0 = dyn_cast<ConstantInt>(GEPInst->getOperand(1))) {
-        if (IDX0->getValue() != 0) {
-          return false;
-        }
+    }
+  }
+  return ConstOffset % ElemSize == 0;
+}
+
+// Follow every use of GV through GEPs, casts, PHIs and selects, and collect
+// the loads and memcpys reading elements through the derived pointers.
+// Returns false if any use can't be rewritten.
+static bool collectAccesses(GlobalVariable &GV, TableAccesses &TA) {
+  const auto &DL = GV.getParent()->getDataLayout();
+  auto *ElemType = GV.getValueType()->getArrayElementType();
+  uint64_t ElemSize = DL.getTypeAllocSize(ElemType);
+
+  SmallPtrSet<Value *, 16> Visited;
+  SmallVector<Value *, 16> Worklist = {&GV};
+  Visited.insert(&GV);
+
+  while (!Worklist.empty()) {
+    auto *V = Worklist.pop_back_val();
+    TA.Pointers.push_back(V);
+
+    for (auto *U : V->users()) {
+      if (isAnnotationUse(U)) {
+        continue;
       }
 
-      // Find all users and see if there's only LoadInst.
-      for (auto *User : GEPInst->users()) {
-        if (auto *LI = dyn_cast<LoadInst>(User)) {
-          continue;
-        } else if (auto *SI = dyn_cast<StoreInst>(User)) {
+      if (auto *GEP = dyn_cast<GEPOperator>(U)) {
+        if (GEP->getPointerOperand() != V || GEP->getType()->isVectorTy() ||
+            !isElementAligned(GEP, DL, ElemSize)) {
           return false;
-        } else {
+        }
+      } else if (isa<BitCastOperator>(U) || isa<AddrSpaceCastOperator>(U) ||
+                 isa<PHINode>(U)) {
+        // Same address, keep following.
+      } else if (auto *SI = dyn_cast<SelectInst>(U)) {
+        if (SI->getCondition() == V) {
           return false;
         }
-      }
-    } else if (auto *GEPOp = dyn_cast<GEPOperator>(U)) {
-      assert(GEPOp->hasOneUser() && "GEP constants should have only one user.");
-
-      // Check the operands. (cstptr, idx0 = 0, idx1)
-      if (GEPOp->getNumOperands() != 3) {
-        return false;
-      }
-      if (auto *IDX0 = dyn_cast<ConstantInt>(GEPOp->getOperand(1))) {
-        if (IDX0->getValue() != 0) {
+      } else if (auto *LI = dyn_cast<LoadInst>(U)) {
+        // Whole elements only, i.e. the element type or a vector of it.
+        auto *LoadType = LI->getType();
+        if (auto *VecType = dyn_cast<FixedVectorType>(LoadType)) {
+          LoadType = VecType->getElementType();
+        }
+        if (!LI->isSimple() || LoadType != ElemType) {
+          return false;
+        }
+        TA.Accesses.push_back(LI);
+        continue;
+      } else if (auto *MT = dyn_cast<MemTransferInst>(U)) {
+        // Copies out of the table with a known number of elements.
+        auto *Length = dyn_cast<ConstantInt>(MT->getLength());
+        if (MT->isVolatile() || MT->getRawSource() != V ||
+            MT->getRawDest() == V || !Length ||
+            Length->getZExtValue() % ElemSize != 0) {
           return false;
         }
+        TA.Accesses.push_back(MT);
+        continue;
+      } else if (isa<ICmpInst>(U)) {
+        // Doesn't read the table.
+        TA.Compared.push_back(V);
+        continue;
       } else {
         return false;
       }
 
-      // Check if the user is LoadInst.
-      auto *User = GEPOp->user_back();
-      if (auto *LI = dyn_cast<LoadInst>(User)) {
-        continue;
-      } else if (auto *SI = dyn_cast<StoreInst>(User)) {
-        // We can't handle StoreInst
-        return false;
-      } else {
-        // We can't handle unknown inst.
-        return false;
+      if (Visited.insert(U).second) {
+        Worklist.push_back(U);
       }
-    } else if (auto *CastOp = dyn_cast<BitCastOperator>(U)) {
-      // Check if U is used in annotations.
-      assert(CastOp->hasOneUser() &&
-             "BitCastOperator should have only one user.");
-      auto *User = CastOp->user_back();
-      if (auto *AnnoStruct = dyn_cast<ConstantStruct>(User)) {
-        if (AnnoStruct->hasOneUser()) {
-          if (auto *AnnoArray =
-                  dyn_cast<ConstantArray>(AnnoStruct->user_back())) {
-            if (AnnoArray->hasOneUser()) {
-              auto *GVar = dyn_cast<GlobalVariable>(AnnoArray->user_back());
-              if (!GVar || GVar->getName() != "llvm.global.annotations") {
-                return false;
-              }
-            } else {
-              return false;
-            }
-          } else {
-            return false;
-          }
-        } else {
+    }
+  }
+
+  // PHIs and selects must only merge pointers into this very table.
+  for (auto *V : TA.Pointers) {
+    if (auto *PN = dyn_cast<PHINode>(V)) {
+      for (auto &Incoming : PN->incoming_values()) {
+        if (!Visited.count(Incoming)) {
           return false;
         }
-      } else {
+      }
+    } else if (auto *SI = dyn_cast<SelectInst>(V)) {
+      if (!Visited.count(SI->getTrueValue()) ||
+          !Visited.count(SI->getFalseValue())) {
         return false;
       }
+    }
+  }
+  return true;
+}
+
+static Value *createAddOffset(IRBuilder<> &IRB, Value *A, Value *B) {
+  if (auto *C = dyn_cast<Constant>(A); C && C->isNullValue()) {
+    return B;
+  }
+  if (auto *C = dyn_cast<Constant>(B); C && C->isNullValue()) {
+    return A;
+  }
+  return IRB.CreateAdd(A, B);
+}
+
+// Emit the byte offset a GEP adds to its base pointer.
+static Value *emitGEPOffset(IRBuilder<> &IRB, const DataLayout &DL,
+                            GEPOperator *GEP, Type *OffsetType) {
+  Value *Result = ConstantInt::get(OffsetType, 0);
+  auto GTI = gep_type_begin(GEP);
+  for (auto *I = GEP->idx_begin(); I != GEP->idx_end(); I++, GTI++) {
+    Value *Offset = nullptr;
+    if (auto *STy = GTI.getStructTypeOrNull()) {
+      auto FieldNo = cast<ConstantInt>(*I)->getZExtValue();
+      Offset = ConstantInt::get(
+          OffsetType, DL.getStructLayout(STy)->getElementOffset(FieldNo));
     } else {
-      return false;
+      uint64_t Stride = DL.getTypeAllocSize(GTI.getIndexedType());
+      Offset = IRB.CreateSExtOrTrunc(*I, OffsetType);
+      if (Stride != 1) {
+        Offset = IRB.CreateMul(Offset, ConstantInt::get(OffsetType, Stride));
+      }
+    }
+    Result = createAddOffset(IRB, Result, Offset);
+  }
+  return Result;
+}
+
+// Materialize the byte offset of a derived pointer from the start of the
+// table, next to the pointer itself.
+static Value *getByteOffset(Value *Ptr, DenseMap<Value *, Value *> &Offsets,
+                            const DataLayout &DL, Type *OffsetType) {
+  if (auto *Offset = Offsets.lookup(Ptr)) {
+    return Offset;
+  }
+
+  // Constant expressions fold without an insertion point.
+  IRBuilder<> IRB(Ptr->getContext());
+  if (auto *I = dyn_cast<Instruction>(Ptr)) {
+    IRB.SetInsertPoint(I);
+  }
+
+  Value *Offset = nullptr;
+  if (auto *GEP = dyn_cast<GEPOperator>(Ptr)) {
+    auto *Base = getByteOffset(GEP->getPointerOperand(), Offsets, DL,
+                               OffsetType);
+    Offset =
+        createAddOffset(IRB, Base, emitGEPOffset(IRB, DL, GEP, OffsetType));
+  } else if (auto *PN = dyn_cast<PHINode>(Ptr)) {
+    auto *OffsetPN = IRB.CreatePHI(OffsetType, PN->getNumIncomingValues());
+    Offsets[Ptr] = OffsetPN;
+    for (unsigned i = 0; i < PN->getNumIncomingValues(); i++) {
+      OffsetPN->addIncoming(getByteOffset(PN->getIncomingValue(i), Offsets,
+                                          DL, OffsetType),
+                            PN->getIncomingBlock(i));
+    }
+    Offset = OffsetPN;
+  } else if (auto *SI = dyn_cast<SelectInst>(Ptr)) {
+    auto *TrueOffset =
+        getByteOffset(SI->getTrueValue(), Offsets, DL, OffsetType);
+    auto *FalseOffset =
+        getByteOffset(SI->getFalseValue(), Offsets, DL, OffsetType);
+    IRB.SetInsertPoint(SI);
+    Offset = IRB.CreateSelect(SI->getCondition(), TrueOffset, FalseOffset);
+  } else {
+    // Casts keep the address.
+    auto *Op = cast<Operator>(Ptr);
+    Offset = getByteOffset(Op->getOperand(0), Offsets, DL, OffsetType);
+  }
+  Offsets[Ptr] = Offset;
+  return Offset;
+}
+
+// Replace memcpy(Dst, Table + Index, N * ElemSize) with a loop storing
+// poly(Index + K) to Dst for K in [0, N).
+static void expandMemTransfer(MemTransferInst *MT, Value *Index,
+                              Function *Polynomial, uint64_t ElemSize) {
+  auto *Length = cast<ConstantInt>(MT->getLength());
+  uint64_t Count = Length->getZExtValue() / ElemSize;
+  if (Count == 0) {
+    MT->eraseFromParent();
+    return;
+  }
+
+  auto *BB = MT->getParent();
+  auto *Exit = SplitBlock(BB, MT);
+  auto *Loop =
+      BasicBlock::Create(MT->getContext(), "interpolate.copy", BB->getParent(),
+                         Exit);
+  BB->getTerminator()->setSuccessor(0, Loop);
+
+  IRBuilder<> IRB(Loop);
+  auto *IndexType = Index->getType();
+  auto *ElemType = Polynomial->getReturnType();
+  auto *K = IRB.CreatePHI(IndexType, 2);
+  auto *Value = IRB.CreateCall(Polynomial, {createAddOffset(IRB, Index, K)});
+  auto *Dst = IRB.CreateGEP(IRB.getInt8Ty(), MT->getRawDest(),
+                            IRB.CreateMul(K, ConstantInt::get(IndexType,
+                                                              ElemSize)));
+  Dst = IRB.CreateBitCast(
+      Dst, ElemType->getPointerTo(MT->getDestAddressSpace()));
+  IRB.CreateAlignedStore(Value, Dst,
+                         commonAlignment(MT->getDestAlign().valueOrOne(),
+                                         ElemSize));
+  auto *NextK = IRB.CreateAdd(K, ConstantInt::get(IndexType, 1));
+  IRB.CreateCondBr(IRB.CreateICmpULT(NextK, ConstantInt::get(IndexType, Count)),
+                   Loop, Exit);
+  K->addIncoming(ConstantInt::get(IndexType, 0), BB);
+  K->addIncoming(NextK, Loop);
+
+  MT->eraseFromParent();
+}
+
+// Analyses bounding the indices read in a function.
+struct IndexRanges {
+  AssumptionCache AC;
+  LazyValueInfo LVI;
+  IndexRanges(Function &F, const DataLayout &DL)
+      : AC(F), LVI(&AC, &DL, nullptr) {}
+};
+
+// Number of consecutive elements an access reads.
+static uint64_t getReadCount(Instruction *I, uint64_t ElemSize) {
+  if (auto *MT = dyn_cast<MemTransferInst>(I)) {
+    return cast<ConstantInt>(MT->getLength())->getZExtValue() / ElemSize;
+  }
+  if (auto *VecType = dyn_cast<FixedVectorType>(I->getType())) {
+    return VecType->getNumElements();
+  }
+  return 1;
+}
+
+// The first and last element I may read from Index on, clamped to the
+// table, as reading out of bounds is undefined anyway.
+static std::pair<uint64_t, uint64_t> getReadRange(IndexRanges &IR,
+                                                  Value *Index,
+                                                  Instruction *I,
+                                                  uint64_t Count,
+                                                  uint64_t Size) {
+  auto Range = IR.LVI.getConstantRange(Index, I).intersectWith(
+      computeConstantRange(Index, /*ForSigned=*/true, true, &IR.AC, I));
+  if (Range.isEmptySet() || Range.getSignedMax().isNegative() ||
+      Range.getSignedMin().sge(Size)) {
+    return {0, Size - 1};
+  }
+  uint64_t First = std::max<int64_t>(Range.getSignedMin().getSExtValue(), 0);
+  uint64_t Last = std::min<int64_t>(Range.getSignedMax().getSExtValue(),
+                                    Size - 1);
+  return {First, std::min(Last + std::max<uint64_t>(Count, 1) - 1, Size - 1)};
+}
+
+static void rewriteAccesses(
+    Module &M, GlobalVariable &GV, TableAccesses &TA,
+    function_ref<TablePolynomial &(uint64_t, uint64_t)> GetPolynomial,
+    const InterpolateOptions &Options) {
+  const auto &DL = M.getDataLayout();
+  auto *OffsetType = DL.getIndexType(GV.getType());
+  uint64_t ElemSize =
+      DL.getTypeAllocSize(GV.getValueType()->getArrayElementType());
+  uint64_t Size = GV.getValueType()->getArrayNumElements();
+  auto *ElemSizeValue = ConstantInt::get(OffsetType, ElemSize);
+
+  DenseMap<Value *, Value *> Offsets;
+  Offsets[&GV] = ConstantInt::get(OffsetType, 0);
+
+  // Compute the index of every access, and the polynomial through the
+  // elements it can reach, before any block is split.
+  DenseMap<Function *, std::unique_ptr<IndexRanges>> Ranges;
+  SmallVector<std::pair<Value *, TablePolynomial *>, 16> Reads;
+  for (auto *I : TA.Accesses) {
+    IRBuilder<> IRB(I);
+    auto *Ptr = isa<LoadInst>(I) ? cast<LoadInst>(I)->getPointerOperand()
+                                 : cast<MemTransferInst>(I)->getRawSource();
+    auto *Index = IRB.CreateExactSDiv(
+        getByteOffset(Ptr, Offsets, DL, OffsetType), ElemSizeValue);
+
+    auto &IR = Ranges[I->getFunction()];
+    if (!IR) {
+      IR = std::make_unique<IndexRanges>(*I->getFunction(), DL);
+    }
+    auto [First, Last] =
+        getReadRange(*IR, Index, I, getReadCount(I, ElemSize), Size);
+    Reads.push_back({Index, &GetPolynomial(First, Last)});
+  }
+  Ranges.clear();
+
+  TableProfile Profile;
+  auto GetFunction = [&](TablePolynomial &TP, unsigned Lanes) {
+    auto *F = getPolynomialFunction(M, TP, Lanes);
+    return Options.Instrument
+               ? getInstrumentedFunction(M, GV, Profile, TP, F, Lanes,
+                                         Options)
+               : F;
+  };
+  for (size_t i = 0; i < TA.Accesses.size(); i++) {
+    auto *I = TA.Accesses[i];
+    auto [Index, TP] = Reads[i];
+    IRBuilder<> IRB(I);
+
+    if (auto *MT = dyn_cast<MemTransferInst>(I)) {
+      expandMemTransfer(MT, Index, GetFunction(*TP, 1), ElemSize);
+      continue;
+    }
+
+    // Replace each LoadInst with a call, vector loads read lanes
+    // Index, Index + 1, ..., which the vector polynomial evaluates at once.
+    unsigned Lanes = 1;
+    if (auto *VecType = dyn_cast<FixedVectorType>(I->getType())) {
+      Lanes = VecType->getNumElements();
+      SmallVector<Constant *, 8> Steps;
+      for (unsigned i = 0; i < Lanes; i++) {
+        Steps.push_back(ConstantInt::get(OffsetType, i));
+      }
+      Index = IRB.CreateAdd(IRB.CreateVectorSplat(Lanes, Index),
+                            ConstantVector::get(Steps));
+    }
+    auto *CI = IRB.CreateCall(GetFunction(*TP, Lanes), {Index});
+    I->replaceAllUsesWith(CI);
+    I->eraseFromParent();
+  }
+
+  // The derived pointers are only used by each other now, apart from those
+  // the kept reads go through and those compared.
+  SmallPtrSet<Value *, 16> Pointers(TA.Pointers.begin(), TA.Pointers.end());
+  SmallPtrSet<Value *, 16> Live;
+  SmallVector<Value *, 16> Worklist(TA.Compared.begin(), TA.Compared.end());
+  for (auto *I : TA.Kept) {
+    Worklist.push_back(isa<LoadInst>(I)
+                           ? cast<LoadInst>(I)->getPointerOperand()
+                           : cast<MemTransferInst>(I)->getRawSource());
+  }
+  while (!Worklist.empty()) {
+    auto *U = cast<User>(Worklist.pop_back_val());
+    if (!Live.insert(U).second) {
+      continue;
+    }
+    for (auto *Op : U->operand_values()) {
+      if (Pointers.count(Op)) {
+        Worklist.push_back(Op);
+      }
+    }
+  }
+
+  SmallVector<Instruction *, 16> DeadInsts;
+  for (auto *V : TA.Pointers) {
+    if (auto *I = dyn_cast<Instruction>(V); I && !Live.count(I)) {
+      I->dropAllReferences();
+      DeadInsts.push_back(I);
+    }
+  }
+  for (auto *I : DeadInsts) {
+    I->eraseFromParent();
+  }
+  GV.removeDeadConstantUsers();
+}
+
+// Move the reads in blocks the profile marks hot to TA.Kept, as a load is
+// much cheaper than evaluating the polynomial. Block frequencies are
+// computed here since earlier rewrites may have changed the functions.
+static void keepHotAccesses(ProfileSummaryInfo &PSI, TableAccesses &TA) {
+  if (!PSI.hasProfileSummary()) {
+    return;
+  }
+
+  MapVector<Function *, SmallVector<Instruction *, 8>> ByFunction;
+  for (auto *I : TA.Accesses) {
+    ByFunction[I->getFunction()].push_back(I);
+  }
+  TA.Accesses.clear();
+  for (auto &Entry : ByFunction) {
+    auto &F = *Entry.first;
+    DominatorTree DT(F);
+    LoopInfo LI(DT);
+    BranchProbabilityInfo BPI(F, LI);
+    BlockFrequencyInfo BFI(F, BPI, LI);
+    for (auto *I : Entry.second) {
+      if (PSI.isHotBlock(I->getParent(), &BFI)) {
+        TA.Kept.push_back(I);
+      } else {
+        TA.Accesses.push_back(I);
+      }
+    }
+  }
+}
+
+// The polynomial through elements First to Last of a table, shared by
+// identical tables and ranges. Slices not much smaller than the table use
+// the polynomial of the whole table rather than another function.
+static TablePolynomial &getRangePolynomial(PolyCache &Cache, Field Kind,
+                                           const GlobalVariable &GV,
+                                           const std::vector<Point> &Points,
+                                           uint64_t First, uint64_t Last,
+                                           const InterpolateOptions &Options) {
+  if ((Last - First + 1) * 100 > Points.size() * Options.MaxSlicePercent) {
+    First = 0;
+    Last = Points.size() - 1;
+  }
+  std::vector<Point> Range(Points.begin() + First, Points.begin() + Last + 1);
+  auto &TP = Cache[{Kind, Range}];
+  if (TP.Name.empty()) {
+    TP.Name = GV.getName().str();
+    if (Range.size() != Points.size()) {
+      if (Options.Verbose) {
+        errs() << __FUNCTION__ << ": Specializing " << GV.getName()
+               << " to [" << First << ", " << Last << "].\n";
+      }
+      TP.Name += "_" + std::to_string(First) + "_" + std::to_string(Last);
     }
+    TP.Kind = Kind;
+    std::tie(TP.P, TP.Modulus) = Kind == Field::Binary
+                                     ? GFLagrangeInterpolate(Range)
+                                     : LagrangeInterpolate(Range);
+  }
+  return TP;
+}
+
+static bool handleRewrite(Module &M, GlobalVariable &GV, Field Kind,
+                          PolyCache &Cache, ProfileSummaryInfo &PSI,
+                          const InterpolateOptions &Options) {
+  // Collect all possible rewrites, bailout if there's no rule
+  // to rewrite.
+  TableAccesses TA;
+  if (!collectAccesses(GV, TA)) {
+    return false;
+  }
+
+  if (Options.KeepHot) {
+    keepHotAccesses(PSI, TA);
+  }
+  if (Options.Verbose && !TA.Kept.empty()) {
+    errs() << __FUNCTION__ << ": Keeping " << TA.Kept.size()
+           << " hot reads of " << GV.getName() << ".\n";
+  }
+  if (TA.Accesses.empty()) {
+    return true;
   }
 
   // Now we know we can handle everything.
-  // Extract the polynomial first.
+  // Extract the points first, each read gets the polynomial through the
+  // elements it can reach.
   auto Points = ExtractIndexValuePairs(GV);
-  auto [P, Modulus] = LagrangeInterpolate(Points);
-
-  // Build the function of polynomial.
-  auto *PolyF = buildPolynomialFunction(M, GV.getName(), P, Modulus);
 
-  // Rewrite the LoadInsts.
-  rewriteLoadInst(GV, PolyF);
+  // Rewrite the accesses.
+  rewriteAccesses(
+      M, GV, TA,
+      [&](uint64_t First, uint64_t Last) -> auto & {
+        return getRangePolynomial(Cache, Kind, GV, Points, First, Last,
+                                  Options);
+      },
+      Options);
 
   return true;
 }
 
-static bool interpolateTable(Module &M, GlobalVariable &GV) {
+static bool interpolateTable(Module &M, GlobalVariable &GV, Field Kind,
+                             PolyCache &Cache, ProfileSummaryInfo &PSI,
+                             const InterpolateOptions &Options) {
   if (!IsValid(GV)) {
     errs() << __FUNCTION__ << ": Skipping " << GV.getName()
            << ", reason: Wrong type for interpolation.\n";
     return false;
   }
-  if (!handleRewrite(M, GV)) {
+  if (Kind == Field::Binary && !IsGFRepresentable(ExtractIndexValuePairs(GV))) {
+    errs() << __FUNCTION__ << ": Skipping " << GV.getName()
+           << ", reason: Too large for GF(2^k) interpolation.\n";
+    return false;
+  }
+  if (!handleRewrite(M, GV, Kind, Cache, PSI, Options)) {
     errs() << __FUNCTION__ << ": Skipping " << GV.getName()
            << ", reason: Not rewritable.\n";
     return false;
@@ -225,31 +1055,43 @@ static bool interpolateTable(Module &M, GlobalVariable &GV) {
   return true;
 }
 
-bool transformModule(Module &M) {
+// With DeferExported, tables other translation units may read are left
+// annotated for the link-time run, which sees the loads of every module.
+bool transformModule(Module &M, const InterpolateOptions &Options) {
   bool Changed = false;
   SmallVector<Constant *, 8> entry;
   SmallVector<GlobalVariable *, 8> GVs;
+  PolyCache Cache;
+  ProfileSummaryInfo PSI(M);
 
   auto *Annotation = M.getNamedGlobal("llvm.global.annotations");
   if (Annotation) {
     auto *Arr = cast<ConstantArray>(Annotation->getOperand(0));
     for (size_t i = 0; i < Arr->getNumOperands(); i++) {
       auto *AnnoStruct = cast<ConstantStruct>(Arr->getOperand(i));
-      auto *Value = AnnoStruct->getOperand(0)->getOperand(
-          0); // Embedded in bitcast constant
+      // Embedded in bitcast and GEP constants, unless pointers are opaque.
+      auto *Value = AnnoStruct->getOperand(0)->stripPointerCasts();
       if (auto *GV = dyn_cast<GlobalVariable>(Value)) {
         auto Anno =
             cast<ConstantDataArray>(
-                cast<GlobalVariable>(AnnoStruct->getOperand(1)->getOperand(0))
+                cast<GlobalVariable>(
+                    AnnoStruct->getOperand(1)->stripPointerCasts())
                     ->getOperand(0))
                 ->getAsCString();
-        if (Anno == "interpolate") {
-          if (interpolateTable(M, *GV)) {
-            Changed = true;
-            GVs.push_back(GV);
-          } else {
-            entry.push_back(AnnoStruct);
+        if (Anno != "interpolate" && Anno != "interpolate_gf") {
+          entry.push_back(AnnoStruct);
+        } else if (Options.DeferExported && !GV->hasLocalLinkage()) {
+          if (Options.Verbose) {
+            errs() << __FUNCTION__ << ": Deferring " << GV->getName()
+                   << " to link time.\n";
           }
+          entry.push_back(AnnoStruct);
+        } else if (interpolateTable(M, *GV,
+                                    Anno == "interpolate_gf" ? Field::Binary
+                                                             : Field::Prime,
+                                    Cache, PSI, Options)) {
+          Changed = true;
+          GVs.push_back(GV);
         } else {
           entry.push_back(AnnoStruct);
         }
@@ -267,9 +1109,13 @@ bool transformModule(Module &M) {
       Annotation->eraseFromParent();
     }
 
-    // Remove interpolated GVs
+    // Remove interpolated GVs, unless other modules or kept reads may still
+    // read them.
     for (auto *GV : GVs) {
-      GV->eraseFromParent();
+      GV->removeDeadConstantUsers();
+      if (GV->hasLocalLinkage() && GV->use_empty()) {
+        GV->eraseFromParent();
+      }
     }
   }
 
@@ -277,11 +1123,28 @@ bool transformModule(Module &M) {
   return Changed;
 }
 
+// The options of a run of the plugin, from its command line. The link-time
+// run has nothing left to defer.
+static InterpolateOptions getPluginOptions(bool LinkTime) {
+  InterpolateOptions Options;
+  Options.DeferExported = DeferLTO && !LinkTime;
+  Options.Instrument = Instrument;
+  Options.SamplePeriod = SamplePeriod;
+  Options.Verbose = Verbose;
+  Options.KeepHot = KeepHot;
+  Options.MaxSlicePercent = MaxSlicePercent;
+  return Options;
+}
+
 #pragma region legacypm
 struct InterpolateLegacyPass : public ModulePass {
   static char ID;
-  InterpolateLegacyPass() : ModulePass(ID) {}
-  bool runOnModule(Module &M) override { return transformModule(M); }
+  bool LinkTime;
+  InterpolateLegacyPass(bool LinkTime = false)
+      : ModulePass(ID), LinkTime(LinkTime) {}
+  bool runOnModule(Module &M) override {
+    return transformModule(M, getPluginOptions(LinkTime));
+  }
 };
 char InterpolateLegacyPass::ID = 0;
 
@@ -290,21 +1153,33 @@ void addInterpolateLegacyPass(const PassManagerBuilder &,
   PM.add(new InterpolateLegacyPass());
 }
 
+void addInterpolateLTOLegacyPass(const PassManagerBuilder &,
+                                 legacy::PassManagerBase &PM) {
+  PM.add(new InterpolateLegacyPass(/*LinkTime=*/true));
+}
+
 static RegisterPass<InterpolateLegacyPass> X("interpolate",
                                              "Interpolation pass");
 static struct RegisterStandardPasses Y(PassManagerBuilder::EP_EarlyAsPossible,
                                        addInterpolateLegacyPass);
 static struct RegisterStandardPasses
     Z(PassManagerBuilder::EP_EnabledOnOptLevel0, addInterpolateLegacyPass);
+static struct RegisterStandardPasses
+    W(PassManagerBuilder::EP_FullLinkTimeOptimizationEarly,
+      addInterpolateLTOLegacyPass);
 #pragma endregion
 
 #pragma region newpm
 #if LLVM_VERSION_MAJOR >= 13
 class InterpolatePass : public llvm::PassInfoMixin<InterpolatePass> {
+  bool LinkTime;
+
 public:
+  InterpolatePass(bool LinkTime = false) : LinkTime(LinkTime) {}
   llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &) {
-    return transformModule(M) ? PreservedAnalyses::none()
-                              : PreservedAnalyses::all();
+    return transformModule(M, getPluginOptions(LinkTime))
+               ? PreservedAnalyses::none()
+               : PreservedAnalyses::all();
   }
   static bool isRequired() { return true; }
 };
@@ -312,10 +1187,26 @@ public:
 PassPluginLibraryInfo getInterpolatePluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "Interpolation pass", LLVM_VERSION_STRING,
           [](PassBuilder &PB) {
+            // For opt, interpolate-lto being the run on the linked module.
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &PM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name != "interpolate" && Name != "interpolate-lto") {
+                    return false;
+                  }
+                  PM.addPass(InterpolatePass(Name == "interpolate-lto"));
+                  return true;
+                });
             PB.registerPipelineStartEPCallback(
                 [](ModulePassManager &PM, OptimizationLevel) {
                   PM.addPass(InterpolatePass());
                 });
+#if LLVM_VERSION_MAJOR >= 15
+            PB.registerFullLinkTimeOptimizationEarlyEPCallback(
+                [](ModulePassManager &PM, OptimizationLevel) {
+                  PM.addPass(InterpolatePass(/*LinkTime=*/true));
+                });
+#endif
           }};
 }
 
@@ -0,0 +1,38 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Counters of an interpolated table, emitted by the pass with
+// -interpolate-instrument. Keep in sync with getProfileRecord.
+struct interpolate_record {
+  const char *name;
+  uint64_t lookups;
+  uint64_t cycles;
+  uint64_t samples;
+  uint64_t powers;
+  struct interpolate_record *next;
+};
+
+static struct interpolate_record *records;
+
+static void dump_records(void) {
+  for (struct interpolate_record *r = records; r; r = r->next) {
+    uint64_t lookups = __atomic_load_n(&r->lookups, __ATOMIC_RELAXED);
+    uint64_t cycles = __atomic_load_n(&r->cycles, __ATOMIC_RELAXED);
+    uint64_t samples = __atomic_load_n(&r->samples, __ATOMIC_RELAXED);
+    fprintf(stderr, "interpolate: %s lookups %" PRIu64 " powers %" PRIu64,
+            r->name, lookups, r->powers);
+    if (samples)
+      fprintf(stderr, " cycles/lookup %" PRIu64, cycles / samples);
+    fputc('\n', stderr);
+  }
+}
+
+// Called by module constructors, before main.
+void __interpolate_register(struct interpolate_record *record) {
+  if (!records)
+    atexit(dump_records);
+  record->next = records;
+  records = record;
+}
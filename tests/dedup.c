@@ -0,0 +1,51 @@
+// RUN: %mycc -o %t.instrumented %s
+// RUN: %t.instrumented | %filecheck --check-prefix=CHECK-OK %s
+// RUN: %clang -fpass-plugin=%plugin -S -emit-llvm -o - %s \
+// RUN:   | %filecheck --check-prefix=CHECK-IR %s
+
+#include <stdint.h>
+#include <stdio.h>
+
+// TABLE_A and TABLE_B are identical and share one polynomial, TABLE_C shares
+// only the modulus with them.
+// CHECK-IR-LABEL: define {{.*}}@main(
+// CHECK-IR-NOT: poly_TABLE_B
+// CHECK-IR: define {{.*}}@poly_TABLE_A(
+// CHECK-IR-NOT: define {{.*}}@poly_TABLE_A(
+// CHECK-IR: define {{.*}}@modpow_{{[0-9]+}}(
+// CHECK-IR-NOT: define {{.*}}@modpow_
+// CHECK-IR: define {{.*}}@poly_TABLE_C(
+// CHECK-IR-NOT: define {{.*}}@modpow_
+// CHECK-IR-NOT: poly_TABLE_B
+__attribute__((annotate("interpolate"))) const uint32_t TABLE_A[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+__attribute__((annotate("interpolate"))) const uint32_t TABLE_B[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+__attribute__((annotate("interpolate"))) const uint32_t TABLE_C[16] = {
+    0x2, 0x7, 0x1, 0x8, 0x2, 0x8, 0x1, 0x8,
+    0x2, 0x8, 0x4, 0x5, 0x9, 0x0, 0x4, 0x5};
+
+const uint32_t REF_AB[16] = {0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+                             0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+const uint32_t REF_C[16] = {0x2, 0x7, 0x1, 0x8, 0x2, 0x8, 0x1, 0x8,
+                            0x2, 0x8, 0x4, 0x5, 0x9, 0x0, 0x4, 0x5};
+
+int main(void) {
+  for (int i = 0; i < 16; i++) {
+    if (TABLE_A[i] != REF_AB[i] || TABLE_B[i] != REF_AB[i] ||
+        TABLE_C[i] != REF_C[i]) {
+      // CHECK-FAIL: Failed
+      printf("Failed\n");
+      return 1;
+    }
+  }
+
+  // CHECK-OK: OK
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,51 @@
+// RUN: %mycc -mllvm -interpolate-instrument \
+// RUN:   -mllvm -interpolate-sample-period=8 -o %t.instrumented %s
+// RUN: %t.instrumented 2> %t.profile | %filecheck --check-prefix=CHECK-OK %s
+// RUN: %filecheck --check-prefix=CHECK-PROFILE \
+// RUN:   --implicit-check-not=interpolate: %s < %t.profile
+
+#include <stdint.h>
+#include <stdio.h>
+
+__attribute__((annotate("interpolate"))) const uint32_t TABLE[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+// Shares the polynomial of TABLE, but counts its own lookups, including those
+// through the slice [0, 7].
+__attribute__((annotate("interpolate"))) const uint32_t TABLE_B[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+const uint32_t REF[16] = {0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+                          0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+int main(void) {
+  for (int i = 0; i < 100; i++) {
+    if (TABLE[i % 16] != REF[i % 16]) {
+      // CHECK-FAIL: Failed
+      printf("Failed\n");
+      return 1;
+    }
+  }
+  for (int i = 0; i < 50; i++) {
+    if (TABLE_B[i % 16] != REF[i % 16]) {
+      printf("Failed\n");
+      return 1;
+    }
+  }
+  for (int i = 0; i < 20; i++) {
+    if (TABLE_B[i & 7] != REF[i & 7]) {
+      printf("Failed\n");
+      return 1;
+    }
+  }
+
+  // CHECK-OK: OK
+  printf("OK\n");
+  return 0;
+}
+
+// The counters are dumped to stderr at exit, before stdout is flushed.
+// CHECK-PROFILE-DAG: interpolate: TABLE lookups 100 powers 15 cycles/lookup
+// CHECK-PROFILE-DAG: interpolate: TABLE_B lookups 70 powers 15 cycles/lookup
@@ -0,0 +1,91 @@
+; With -interpolate-defer-lto, the exported TABLE is left annotated and
+; interpolated by the link-time run, which also sees the reads in main.ll.
+; RUN: rm -rf %t && split-file %s %t
+; RUN: opt -enable-new-pm=0 -load %plugin -interpolate -S %t/table.ll \
+; RUN:   | %filecheck --check-prefix=CHECK-EAGER %s
+; RUN: opt -enable-new-pm=0 -load %plugin -interpolate -interpolate-defer-lto \
+; RUN:   -interpolate-verbose -mtriple=%host_triple -data-layout=e \
+; RUN:   %t/table.ll -o %t/table.bc 2>&1 \
+; RUN:   | %filecheck --check-prefix=CHECK-DEFER %s
+; RUN: opt -enable-new-pm=0 -load %plugin -interpolate -interpolate-defer-lto \
+; RUN:   -mtriple=%host_triple -data-layout=e %t/main.ll -o %t/main.bc
+; RUN: llvm-link %t/table.bc %t/main.bc -o %t/linked.bc
+; RUN: opt -load-pass-plugin=%plugin -passes=interpolate-lto -S %t/linked.bc \
+; RUN:   -o %t/lto.ll
+; RUN: %filecheck --check-prefix=CHECK-LTO %s < %t/lto.ll
+; RUN: lli %t/lto.ll
+
+; The same link through the LTO library, as a linker loading the plugin runs
+; it.
+; RUN: llvm-lto2 run --load=%plugin --use-new-pm=false -save-temps \
+; RUN:   %t/table.bc %t/main.bc -o %t/out -r %t/table.bc,TABLE,px \
+; RUN:   -r %t/table.bc,get,px -r %t/main.bc,main,px -r %t/main.bc,TABLE, \
+; RUN:   -r %t/main.bc,get,
+; RUN: llvm-dis %t/out.0.4.opt.bc -o - \
+; RUN:   | %filecheck --check-prefix=CHECK-LINK %s
+
+; CHECK-EAGER-NOT: llvm.global.annotations
+; CHECK-EAGER-LABEL: define {{.*}}@get(
+; CHECK-EAGER-NOT: load
+; CHECK-EAGER: call i32 @poly_TABLE(
+
+; CHECK-DEFER: Deferring TABLE to link time.
+
+; CHECK-LTO-NOT: llvm.global.annotations
+; CHECK-LTO-LABEL: define {{.*}}@get(
+; CHECK-LTO-NOT: load
+; CHECK-LTO: call i32 @poly_TABLE(
+; CHECK-LTO-LABEL: define {{.*}}@main(
+; CHECK-LTO-NOT: load
+; CHECK-LTO: call i32 @poly_TABLE(
+; CHECK-LTO-LABEL: define {{.*}}@poly_TABLE(
+
+; CHECK-LINK-NOT: llvm.global.annotations
+; CHECK-LINK-LABEL: define {{.*}}@get(
+; CHECK-LINK-NOT: load
+; CHECK-LINK: call {{.*}}i32 @poly_TABLE(
+; CHECK-LINK-LABEL: define {{.*}}@main(
+; CHECK-LINK-NOT: load
+; CHECK-LINK: call {{.*}}i32 @poly_TABLE(
+; CHECK-LINK-LABEL: define {{.*}}@poly_TABLE(
+
+;--- table.ll
+@TABLE = dso_local constant [16 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6, i32 5, i32 3, i32 5, i32 8, i32 9, i32 7, i32 9, i32 3], align 16
+@.str = private unnamed_addr constant [12 x i8] c"interpolate\00", section "llvm.metadata"
+@.str.1 = private unnamed_addr constant [8 x i8] c"table.c\00", section "llvm.metadata"
+@llvm.global.annotations = appending global [1 x { i8*, i8*, i8*, i32, i8* }] [{ i8*, i8*, i8*, i32, i8* } { i8* bitcast ([16 x i32]* @TABLE to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([8 x i8], [8 x i8]* @.str.1, i32 0, i32 0), i32 1, i8* null }], section "llvm.metadata"
+
+define dso_local i32 @get(i64 %i) {
+  %p = getelementptr inbounds [16 x i32], [16 x i32]* @TABLE, i64 0, i64 %i
+  %v = load i32, i32* %p, align 4
+  ret i32 %v
+}
+
+;--- main.ll
+@TABLE = external dso_local constant [16 x i32], align 16
+
+declare i32 @get(i64)
+
+; Returns 0 if TABLE[i] + get(15 - i) sums to twice the sum of TABLE.
+define dso_local i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %p = getelementptr inbounds [16 x i32], [16 x i32]* @TABLE, i64 0, i64 %i
+  %a = load i32, i32* %p, align 4
+  %j = sub i64 15, %i
+  %b = call i32 @get(i64 %j)
+  %ab = add i32 %a, %b
+  %sum.next = add i32 %sum, %ab
+  %next = add i64 %i, 1
+  %done = icmp eq i64 %next, 16
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %ok = icmp eq i32 %sum.next, 160
+  %ret = select i1 %ok, i32 0, i32 1
+  ret i32 %ret
+}
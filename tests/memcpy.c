@@ -0,0 +1,32 @@
+// RUN: %mycc -o %t.instrumented %s
+// RUN: %t.instrumented | %filecheck --check-prefix=CHECK-OK %s
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+__attribute__((annotate("interpolate"))) static const uint32_t TABLE[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+static const uint32_t REF[16] = {0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+                                 0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+int main(void) {
+  uint32_t Copy[16];
+  uint32_t Half[8];
+
+  memcpy(Copy, TABLE, sizeof(Copy));
+  memcpy(Half, TABLE + 8, sizeof(Half));
+  for (int i = 0; i < 16; i++) {
+    if (Copy[i] != REF[i] || (i < 8 && Half[i] != REF[i + 8])) {
+      // CHECK-FAIL: Failed
+      printf("Failed\n");
+      return 1;
+    }
+  }
+
+  // CHECK-OK: OK
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+// RUN: %mycc -fprofile-instr-generate -o %t.gen %s
+// RUN: env LLVM_PROFILE_FILE=%t.profraw %t.gen
+// RUN: llvm-profdata merge -o %t.profdata %t.profraw
+// RUN: %mycc -fprofile-instr-use=%t.profdata -mllvm -interpolate-verbose \
+// RUN:   -o %t.instrumented %s 2>&1 \
+// RUN:   | %filecheck --check-prefix=CHECK-KEEP %s
+// RUN: %t.instrumented | %filecheck --check-prefix=CHECK-OK %s
+
+#include <stdint.h>
+#include <stdio.h>
+
+// The read in the loop of main is hot and stays a load, the one in check
+// runs once and is interpolated.
+// CHECK-KEEP: Keeping 1 hot reads of TABLE.
+__attribute__((annotate("interpolate"))) const uint32_t TABLE[16] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6,
+    0x5, 0x3, 0x5, 0x8, 0x9, 0x7, 0x9, 0x3};
+
+__attribute__((noinline)) static int check(uint32_t sum) {
+  return sum == 4991 && TABLE[7] == 6;
+}
+
+int main(void) {
+  uint32_t sum = 0;
+  for (int i = 0; i < 1000; i++) {
+    sum += TABLE[i % 16];
+  }
+
+  if (!check(sum)) {
+    // CHECK-FAIL: Failed
+    printf("Failed\n");
+    return 1;
+  }
+
+  // CHECK-OK: OK
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,43 @@
+// RUN: %mycc -mllvm -interpolate-verbose -o %t.instrumented %s 2> %t.log
+// RUN: %filecheck --check-prefix=CHECK-RANGE %s < %t.log
+// RUN: %filecheck --check-prefix=CHECK-WHOLE %s < %t.log
+// RUN: %t.instrumented | %filecheck --check-prefix=CHECK-OK %s
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Reads through masked indices only reach a slice of the table and get a
+// polynomial of lower degree. [1, 63] is most of the table, and keeps the
+// polynomial of the whole table.
+// CHECK-RANGE-DAG: Specializing TABLE to [0, 15].
+// CHECK-RANGE-DAG: Specializing TABLE to [32, 39].
+// CHECK-WHOLE-NOT: Specializing TABLE to [1, 63].
+__attribute__((annotate("interpolate"))) const uint32_t TABLE[64] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6, 0x5, 0x3, 0x5, 0x8, 0x9,
+    0x7, 0x9, 0x3, 0x2, 0x3, 0x8, 0x4, 0x6, 0x2, 0x6, 0x4, 0x3, 0x3,
+    0x8, 0x3, 0x2, 0x7, 0x9, 0x5, 0x0, 0x2, 0x8, 0x8, 0x4, 0x1, 0x9,
+    0x7, 0x1, 0x6, 0x9, 0x3, 0x9, 0x9, 0x3, 0x7, 0x5, 0x1, 0x0, 0x5,
+    0x8, 0x2, 0x0, 0x9, 0x7, 0x4, 0x9, 0x4, 0x4, 0x5, 0x9, 0x2};
+
+const uint32_t REF[64] = {
+    0x3, 0x1, 0x4, 0x1, 0x5, 0x9, 0x2, 0x6, 0x5, 0x3, 0x5, 0x8, 0x9,
+    0x7, 0x9, 0x3, 0x2, 0x3, 0x8, 0x4, 0x6, 0x2, 0x6, 0x4, 0x3, 0x3,
+    0x8, 0x3, 0x2, 0x7, 0x9, 0x5, 0x0, 0x2, 0x8, 0x8, 0x4, 0x1, 0x9,
+    0x7, 0x1, 0x6, 0x9, 0x3, 0x9, 0x9, 0x3, 0x7, 0x5, 0x1, 0x0, 0x5,
+    0x8, 0x2, 0x0, 0x9, 0x7, 0x4, 0x9, 0x4, 0x4, 0x5, 0x9, 0x2};
+
+int main(void) {
+  for (unsigned i = 0; i < 64; i++) {
+    if (TABLE[i & 15] != REF[i & 15] ||
+        TABLE[32 + (i & 7)] != REF[32 + (i & 7)] || TABLE[i] != REF[i] ||
+        TABLE[1 + i % 63] != REF[1 + i % 63]) {
+      // CHECK-FAIL: Failed
+      printf("Failed\n");
+      return 1;
+    }
+  }
+
+  // CHECK-OK: OK
+  printf("OK\n");
+  return 0;
+}
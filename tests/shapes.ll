@@ -0,0 +1,150 @@
+; Reads through every pointer shape collectAccesses follows are rewritten,
+; and still read the same values as the plain table R.
+; RUN: opt -enable-new-pm=0 -load %plugin -interpolate -S %s -o %t.ll
+; RUN: %filecheck --check-prefix=CHECK-IR %s < %t.ll
+; RUN: lli %t.ll
+
+@T = internal constant [16 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6, i32 5, i32 3, i32 5, i32 8, i32 9, i32 7, i32 9, i32 3], align 16
+@R = internal constant [16 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6, i32 5, i32 3, i32 5, i32 8, i32 9, i32 7, i32 9, i32 3], align 16
+@.str = private unnamed_addr constant [12 x i8] c"interpolate\00", section "llvm.metadata"
+@.str.1 = private unnamed_addr constant [9 x i8] c"shapes.c\00", section "llvm.metadata"
+@llvm.global.annotations = appending global [1 x { i8*, i8*, i8*, i32, i8* }] [{ i8*, i8*, i8*, i32, i8* } { i8* bitcast ([16 x i32]* @T to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([9 x i8], [9 x i8]* @.str.1, i32 0, i32 0), i32 1, i8* null }], section "llvm.metadata"
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i1)
+
+; A pointer incremented by a PHI, counted.
+; CHECK-IR-LABEL: define i32 @sum_phi(
+; CHECK-IR-NOT: load
+; CHECK-IR: call i32 @poly_T(
+define i32 @sum_phi() {
+entry:
+  %start = getelementptr [16 x i32], [16 x i32]* @T, i64 0, i64 0
+  br label %loop
+
+loop:
+  %p = phi i32* [ %start, %entry ], [ %next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %k = phi i64 [ 0, %entry ], [ %k.next, %loop ]
+  %v = load i32, i32* %p, align 4
+  %acc.next = add i32 %acc, %v
+  %next = getelementptr i32, i32* %p, i64 1
+  %k.next = add i64 %k, 1
+  %c = icmp ult i64 %k.next, 16
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
+
+; for (p = T; p != T + 16; p++), the comparison keeps the pointers.
+; CHECK-IR-LABEL: define i32 @sum_to_end(
+; CHECK-IR-NOT: load
+; CHECK-IR: call i32 @poly_T(
+; CHECK-IR: icmp eq i32* %next, getelementptr
+define i32 @sum_to_end() {
+entry:
+  br label %loop
+
+loop:
+  %p = phi i32* [ getelementptr ([16 x i32], [16 x i32]* @T, i64 0, i64 0), %entry ], [ %next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %v = load i32, i32* %p, align 4
+  %acc.next = add i32 %acc, %v
+  %next = getelementptr inbounds i32, i32* %p, i64 1
+  %c = icmp eq i32* %next, getelementptr ([16 x i32], [16 x i32]* @T, i64 1, i64 0)
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+}
+
+; A select between a byte-offset GEP and a constant one.
+; CHECK-IR-LABEL: define i32 @select_bytes(
+; CHECK-IR-NOT: load
+; CHECK-IR: call i32 @poly_T(
+define i32 @select_bytes(i1 %b, i64 %i) {
+  %base = bitcast [16 x i32]* @T to i8*
+  %off = shl i64 %i, 2
+  %a = getelementptr i8, i8* %base, i64 %off
+  %c = getelementptr i8, i8* %base, i64 8
+  %s = select i1 %b, i8* %a, i8* %c
+  %p = bitcast i8* %s to i32*
+  %v = load i32, i32* %p, align 4
+  ret i32 %v
+}
+
+; CHECK-IR-LABEL: define <4 x i32> @vector(
+; CHECK-IR-NOT: load
+; CHECK-IR: call <4 x i32> @poly_T_v4(
+define <4 x i32> @vector(i64 %i) {
+  %p = getelementptr [16 x i32], [16 x i32]* @T, i64 0, i64 %i
+  %q = bitcast i32* %p to <4 x i32>*
+  %v = load <4 x i32>, <4 x i32>* %q, align 4
+  ret <4 x i32> %v
+}
+
+; CHECK-IR-LABEL: define i32 @copy(
+; CHECK-IR-NOT: @llvm.memcpy
+; CHECK-IR: call i32 @poly_T(
+define i32 @copy(i64 %i) {
+  %buf = alloca [16 x i32], align 4
+  %d = bitcast [16 x i32]* %buf to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* bitcast ([16 x i32]* @T to i8*), i64 64, i1 false)
+  %p = getelementptr [16 x i32], [16 x i32]* %buf, i64 0, i64 %i
+  %v = load i32, i32* %p, align 4
+  ret i32 %v
+}
+
+define i32 @read_ref(i64 %i) {
+  %p = getelementptr [16 x i32], [16 x i32]* @R, i64 0, i64 %i
+  %v = load i32, i32* %p, align 4
+  ret i32 %v
+}
+
+; Returns 0 if every read matches R.
+define i32 @main() {
+entry:
+  %phi = call i32 @sum_phi()
+  %to.end = call i32 @sum_to_end()
+  %bad.phi = icmp ne i32 %phi, 80
+  %bad.end = icmp ne i32 %to.end, 80
+  %bad.sums = or i1 %bad.phi, %bad.end
+  br i1 %bad.sums, label %fail, label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %next ]
+  %ref = call i32 @read_ref(i64 %i)
+  %sel = call i32 @select_bytes(i1 true, i64 %i)
+  %bad.sel = icmp ne i32 %sel, %ref
+  %copied = call i32 @copy(i64 %i)
+  %bad.copy = icmp ne i32 %copied, %ref
+  %j = and i64 %i, 7
+  %vec = call <4 x i32> @vector(i64 %j)
+  %lane.0 = extractelement <4 x i32> %vec, i64 0
+  %ref.0 = call i32 @read_ref(i64 %j)
+  %bad.lane.0 = icmp ne i32 %lane.0, %ref.0
+  %lane.3 = extractelement <4 x i32> %vec, i64 3
+  %j3 = add i64 %j, 3
+  %ref.3 = call i32 @read_ref(i64 %j3)
+  %bad.lane.3 = icmp ne i32 %lane.3, %ref.3
+  %bad.1 = or i1 %bad.sel, %bad.copy
+  %bad.2 = or i1 %bad.lane.0, %bad.lane.3
+  %bad = or i1 %bad.1, %bad.2
+  br i1 %bad, label %fail, label %next
+
+next:
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, 16
+  br i1 %done, label %const, label %loop
+
+const:
+  %eight = call i32 @select_bytes(i1 false, i64 0)
+  %bad.const = icmp ne i32 %eight, 4
+  br i1 %bad.const, label %fail, label %pass
+
+pass:
+  ret i32 0
+
+fail:
+  ret i32 1
+}
@@ -0,0 +1,79 @@
+; Tables read in ways the pass can't rewrite are left alone entirely.
+; RUN: opt -enable-new-pm=0 -load %plugin -interpolate -S %s -o %t.ll 2>&1 \
+; RUN:   | %filecheck --check-prefix=CHECK-SKIP %s
+; RUN: %filecheck --check-prefix=CHECK-IR %s < %t.ll
+
+; CHECK-SKIP: Skipping UNALIGNED, reason: Not rewritable.
+; CHECK-SKIP: Skipping MISALIGNED, reason: Not rewritable.
+; CHECK-SKIP: Skipping NARROW, reason: Not rewritable.
+; CHECK-SKIP: Skipping VOLATILE, reason: Not rewritable.
+; CHECK-SKIP: Skipping VECTOR_GEP, reason: Not rewritable.
+; CHECK-SKIP: Skipping FOREIGN_PHI, reason: Not rewritable.
+
+; CHECK-IR: @llvm.global.annotations = {{.*}}[6 x
+; CHECK-IR-NOT: poly_
+@UNALIGNED = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@MISALIGNED = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@NARROW = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@VOLATILE = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@VECTOR_GEP = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@FOREIGN_PHI = internal constant [8 x i32] [i32 3, i32 1, i32 4, i32 1, i32 5, i32 9, i32 2, i32 6], align 16
+@.str = private unnamed_addr constant [12 x i8] c"interpolate\00", section "llvm.metadata"
+@.str.1 = private unnamed_addr constant [15 x i8] c"unrewritable.c\00", section "llvm.metadata"
+@llvm.global.annotations = appending global [6 x { i8*, i8*, i8*, i32, i8* }] [{ i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @UNALIGNED to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 1, i8* null }, { i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @MISALIGNED to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 2, i8* null }, { i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @NARROW to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 3, i8* null }, { i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @VOLATILE to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 4, i8* null }, { i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @VECTOR_GEP to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 5, i8* null }, { i8*, i8*, i8*, i32, i8* } { i8* bitcast ([8 x i32]* @FOREIGN_PHI to i8*), i8* getelementptr inbounds ([12 x i8], [12 x i8]* @.str, i32 0, i32 0), i8* getelementptr inbounds ([15 x i8], [15 x i8]* @.str.1, i32 0, i32 0), i32 6, i8* null }], section "llvm.metadata"
+
+; A byte offset that may point into the middle of an element.
+define i32 @unaligned(i64 %i) {
+  %base = bitcast [8 x i32]* @UNALIGNED to i8*
+  %a = getelementptr i8, i8* %base, i64 %i
+  %p = bitcast i8* %a to i32*
+  %v = load i32, i32* %p, align 1
+  ret i32 %v
+}
+
+define i32 @misaligned(i64 %i) {
+  %base = bitcast [8 x i32]* @MISALIGNED to i8*
+  %off = shl i64 %i, 2
+  %a = getelementptr i8, i8* %base, i64 %off
+  %b = getelementptr i8, i8* %a, i64 2
+  %p = bitcast i8* %b to i32*
+  %v = load i32, i32* %p, align 2
+  ret i32 %v
+}
+
+; Part of an element only.
+define i8 @narrow(i64 %i) {
+  %p = getelementptr [8 x i32], [8 x i32]* @NARROW, i64 0, i64 %i
+  %q = bitcast i32* %p to i8*
+  %v = load i8, i8* %q, align 4
+  ret i8 %v
+}
+
+define i32 @volatile(i64 %i) {
+  %p = getelementptr [8 x i32], [8 x i32]* @VOLATILE, i64 0, i64 %i
+  %v = load volatile i32, i32* %p, align 4
+  ret i32 %v
+}
+
+define <2 x i32> @vector_gep(<2 x i64> %i) {
+  %p = getelementptr [8 x i32], [8 x i32]* @VECTOR_GEP, <2 x i64> zeroinitializer, <2 x i64> %i
+  %v = call <2 x i32> @llvm.masked.gather.v2i32.v2p0i32(<2 x i32*> %p, i32 4, <2 x i1> <i1 true, i1 true>, <2 x i32> undef)
+  ret <2 x i32> %v
+}
+
+declare <2 x i32> @llvm.masked.gather.v2i32.v2p0i32(<2 x i32*>, i32, <2 x i1>, <2 x i32>)
+
+; A PHI that may also point outside the table.
+define i32 @foreign_phi(i1 %b, i32* %other) {
+entry:
+  br i1 %b, label %table, label %exit
+
+table:
+  %p = getelementptr [8 x i32], [8 x i32]* @FOREIGN_PHI, i64 0, i64 1
+  br label %exit
+
+exit:
+  %q = phi i32* [ %p, %table ], [ %other, %entry ]
+  %v = load i32, i32* %q, align 4
+  ret i32 %v
+}